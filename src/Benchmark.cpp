@@ -0,0 +1,314 @@
+#ifdef HEADLESS
+// Include guard HEADLESS
+
+#include "Benchmark.hpp"
+
+#include "DynamicArray.hpp"
+#include "RenderStats.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm> // std::sort
+#include <chrono>
+#include <cstdio>    // Checksum files
+#include <cstdlib>   // atoi, atof
+#include <cstring>   // strcmp
+#include <iostream>
+#include <sys/resource.h> // getrusage
+
+struct FrameSample
+{
+    uint64_t ns;
+    uint32_t triangles_drawn;
+    uint32_t pixels_written;
+    uint32_t faces_culled;
+    uint32_t models_culled;
+    uint32_t pixels_cleared;
+#ifdef FRAME_PROFILER
+    uint32_t zone_us[PROF_ZONE_COUNT];
+#endif
+};
+
+static DynamicArray<FrameSample> frame_samples;
+static std::chrono::steady_clock::time_point frame_t0;
+static std::chrono::steady_clock::time_point load_t0;
+static uint64_t load_ns = 0;
+
+static FILE* checksum_file = nullptr;
+static FILE* verify_file   = nullptr;
+
+static void bench_usage(const char* exe)
+{
+    std::cout
+        << "Usage: " << exe << " [options]\n"
+        << "  --frames N       Frames to run (default 600)\n"
+        << "  --dt SECONDS     Fixed delta-time per frame (default 0.033)\n"
+        << "  --render-mode M  Car render mode 0-3 (default 3, TEXTURED_LIGHT)\n"
+        << "  --record FILE    Record inputs of the run\n"
+        << "  --replay FILE    Replay recorded inputs (and dt unless --dt is given)\n"
+        << "  --checksums FILE Write per-frame car & screen checksums\n"
+        << "  --verify FILE    Stop at first frame whose checksums differ from FILE\n"
+        << "  --map FILE       Load FILE instead of python/little_map.map (see tools/MapGen.cpp)\n"
+        << "  --far DISTANCE   Far plane distance (default " << FAR_DISTANCE_DEFAULT << ")\n"
+        << "  --zbuffer on|off Depth buffer instead of sorting faces and models (default "
+        << (Z_BUFFER_DEFAULT ? "on" : "off") << ")\n"
+        << "  --threads N      Job threads for transforms and screen tiles (default 0, one per core)\n"
+        << "  --pipeline       Simulate the next frame while drawing one (screen one frame behind)\n"
+        << "  --golden-write DIR      Render golden poses to DIR and exit\n"
+        << "  --golden-check DIR      Compare golden poses against DIR and exit\n"
+        << "  --golden-tolerance N    Max per-channel difference (default 0)\n"
+        << "  --golden-max-pixels N   Pixels allowed over the tolerance (default 0)\n"
+        << std::endl;
+}
+
+bool bench_parse_args(int argc, const char* argv[], BenchConfig& config)
+{
+    config.frames      = 600;
+    config.dt          = 1.0f / 30.0f;
+    config.dt_override = false;
+    config.render_mode = 3;
+    config.record_path   = nullptr;
+    config.replay_path   = nullptr;
+    config.checksum_path = nullptr;
+    config.verify_path   = nullptr;
+    config.map_path      = nullptr;
+    config.far_distance  = FAR_DISTANCE_DEFAULT;
+    config.z_buffer      = Z_BUFFER_DEFAULT;
+    config.threads       = 0;
+    config.pipeline      = false;
+    config.golden_write_dir  = nullptr;
+    config.golden_check_dir  = nullptr;
+    config.golden_tolerance  = 0;
+    config.golden_max_pixels = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const bool has_value = (i + 1 < argc);
+        if      (strcmp(argv[i], "--frames") == 0 && has_value)
+            config.frames = (uint32_t) atoi(argv[++i]);
+        else if (strcmp(argv[i], "--dt") == 0 && has_value) {
+            config.dt = (float) atof(argv[++i]);
+            config.dt_override = true;
+        }
+        else if (strcmp(argv[i], "--render-mode") == 0 && has_value)
+            config.render_mode = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--record") == 0 && has_value)
+            config.record_path = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && has_value)
+            config.replay_path = argv[++i];
+        else if (strcmp(argv[i], "--checksums") == 0 && has_value)
+            config.checksum_path = argv[++i];
+        else if (strcmp(argv[i], "--verify") == 0 && has_value)
+            config.verify_path = argv[++i];
+        else if (strcmp(argv[i], "--map") == 0 && has_value)
+            config.map_path = argv[++i];
+        else if (strcmp(argv[i], "--far") == 0 && has_value)
+            config.far_distance = (float) atof(argv[++i]);
+        else if (strcmp(argv[i], "--zbuffer") == 0 && has_value)
+            config.z_buffer = strcmp(argv[++i], "on") == 0;
+        else if (strcmp(argv[i], "--threads") == 0 && has_value)
+            config.threads = (unsigned) atoi(argv[++i]);
+        else if (strcmp(argv[i], "--pipeline") == 0)
+            config.pipeline = true;
+        else if (strcmp(argv[i], "--golden-write") == 0 && has_value)
+            config.golden_write_dir = argv[++i];
+        else if (strcmp(argv[i], "--golden-check") == 0 && has_value)
+            config.golden_check_dir = argv[++i];
+        else if (strcmp(argv[i], "--golden-tolerance") == 0 && has_value)
+            config.golden_tolerance = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--golden-max-pixels") == 0 && has_value)
+            config.golden_max_pixels = (uint32_t) atoi(argv[++i]);
+        else {
+            bench_usage(argv[0]);
+            return false;
+        }
+    }
+    if (config.frames == 0 || config.dt <= 0.0f || config.render_mode < 0 || config.render_mode > 3
+        || config.far_distance <= 0.0f) {
+        bench_usage(argv[0]);
+        return false;
+    }
+    return true;
+}
+
+bool bench_open(const BenchConfig& config)
+{
+    if (config.checksum_path) {
+        checksum_file = fopen(config.checksum_path, "w");
+        if (!checksum_file) {
+            std::cout << "Could not create " << config.checksum_path << std::endl;
+            return false;
+        }
+    }
+    if (config.verify_path) {
+        verify_file = fopen(config.verify_path, "r");
+        if (!verify_file) {
+            std::cout << "Could not read " << config.verify_path << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool bench_checksum_frame(uint32_t frame, uint32_t car_checksum, uint32_t screen_checksum)
+{
+    if (checksum_file)
+        fprintf(checksum_file, "%u %08x %08x\n", frame, car_checksum, screen_checksum);
+
+    if (verify_file) {
+        unsigned ref_frame, ref_car, ref_screen;
+        if (fscanf(verify_file, "%u %x %x", &ref_frame, &ref_car, &ref_screen) != 3) {
+            std::cout << "Verify file ended at frame " << frame << std::endl;
+            return false;
+        }
+        if (ref_frame != frame || ref_car != car_checksum || ref_screen != screen_checksum) {
+            std::cout
+                << "Diverged at frame " << frame << ":"
+                << (ref_car    != car_checksum    ? " car state" : "")
+                << (ref_screen != screen_checksum ? " screen"    : "")
+                << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+BenchInput bench_script_input(uint32_t frame)
+{
+    // One 240 frame lap: accelerate, steer both ways, boost, brake.
+    // Camera preset is switched once per lap.
+    const uint32_t t = frame % 240;
+
+    BenchInput in = {};
+    in.brake         = (t >= 200 && t < 220);
+    in.accelerate    = !in.brake;
+    in.turn_left     = (t >=  30 && t <  70);
+    in.turn_right    = (t >= 100 && t < 140);
+    in.boost         = (t >= 150 && t < 156);
+    in.camera_preset = (t == 120);
+    in.render_mode   = false;
+    return in;
+}
+
+void bench_load_begin()
+{
+    load_t0 = std::chrono::steady_clock::now();
+}
+
+void bench_load_end()
+{
+    load_ns = (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - load_t0
+    ).count();
+}
+
+void bench_frame_begin()
+{
+#ifdef RENDER_STATS
+    render_stats = {0, 0, 0, 0, 0};
+#endif
+    frame_t0 = std::chrono::steady_clock::now();
+}
+
+void bench_frame_end()
+{
+    const auto frame_t1 = std::chrono::steady_clock::now();
+    FrameSample sample;
+    sample.ns = (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(frame_t1 - frame_t0).count();
+#ifdef RENDER_STATS
+    sample.triangles_drawn = render_stats.triangles_drawn;
+    sample.pixels_written  = render_stats.pixels_written;
+    sample.faces_culled    = render_stats.faces_culled;
+    sample.models_culled   = render_stats.models_culled;
+    sample.pixels_cleared  = render_stats.pixels_cleared;
+#else
+    sample.triangles_drawn = 0;
+    sample.pixels_written  = 0;
+    sample.faces_culled    = 0;
+    sample.models_culled   = 0;
+    sample.pixels_cleared  = 0;
+#endif
+#ifdef FRAME_PROFILER
+    for (uint8_t z = 0; z < PROF_ZONE_COUNT; z++)
+        sample.zone_us[z] = profiler_last_frame_us(z);
+#endif
+    frame_samples.push_back(sample);
+}
+
+// Nearest-rank percentile of sorted array
+static uint64_t percentile(const uint64_t* sorted, unsigned count, unsigned perc)
+{
+    unsigned rank = (perc * count + 99) / 100;
+    if (rank == 0) rank = 1;
+    return sorted[rank - 1];
+}
+
+void bench_report(const BenchConfig& config, unsigned model_count, uint32_t scratch_high_water)
+{
+    if (checksum_file) fclose(checksum_file);
+    if (verify_file)   fclose(verify_file);
+    checksum_file = nullptr;
+    verify_file   = nullptr;
+
+    const unsigned count = frame_samples.getSize();
+    if (count == 0)
+        return;
+
+    DynamicArray<uint64_t> sorted_ns;
+    sorted_ns.reserve(count);
+    uint64_t total_ns = 0;
+    uint64_t total_triangles = 0;
+    uint64_t total_pixels = 0;
+    uint64_t total_culled = 0;
+    uint64_t total_models_culled = 0;
+    uint64_t total_cleared = 0;
+    for (unsigned i = 0; i < count; i++) {
+        sorted_ns.push_back(frame_samples[i].ns);
+        total_ns        += frame_samples[i].ns;
+        total_triangles += frame_samples[i].triangles_drawn;
+        total_pixels    += frame_samples[i].pixels_written;
+        total_culled    += frame_samples[i].faces_culled;
+        total_models_culled += frame_samples[i].models_culled;
+        total_cleared   += frame_samples[i].pixels_cleared;
+    }
+    uint64_t* ns = sorted_ns.getRawArray();
+    std::sort(ns, ns + count);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    std::cout
+        << "frames:          " << count << " (dt " << config.dt << " s, render mode " << config.render_mode << ")\n"
+        << "models:          " << model_count << "\n"
+        << "map load [ms]:   " << load_ns / 1000000 << "." << (load_ns / 100000) % 10
+        << " (" << (config.map_path ? config.map_path : "python/little_map.map") << ")\n"
+        << "peak RSS [KB]:   " << usage.ru_maxrss << "\n"
+        << "scratch peak:    " << scratch_high_water << " B\n"
+        << "frame time [us]: min " << ns[0] / 1000
+        << "  p50 "  << percentile(ns, count, 50) / 1000
+        << "  p99 "  << percentile(ns, count, 99) / 1000
+        << "  max "  << ns[count - 1] / 1000
+        << "  mean " << total_ns / count / 1000 << "\n"
+        << "triangles drawn: " << total_triangles << " total, " << total_triangles / count << " per frame\n"
+        << "pixels written:  " << total_pixels    << " total, " << total_pixels    / count << " per frame\n"
+        << "faces culled:    " << total_culled    << " total, " << total_culled    / count << " per frame\n"
+        << "models culled:   " << total_models_culled << " total, " << total_models_culled / count << " per frame"
+        << " (far " << config.far_distance << ")\n"
+        << "pixels cleared:  " << total_cleared   << " total, " << total_cleared   / count << " per frame\n"
+        << "visibility:      " << (config.z_buffer ? "depth buffer" : "sorting") << "\n"
+        << "threads:         " << config.threads << "\n"
+        << "pipeline:        " << (config.pipeline ? "on" : "off")
+        << std::endl;
+
+#ifdef FRAME_PROFILER
+    std::cout << "stage mean [us]:";
+    for (uint8_t z = 0; z < PROF_ZONE_COUNT; z++) {
+        uint64_t zone_total = 0;
+        for (unsigned i = 0; i < count; i++)
+            zone_total += frame_samples[i].zone_us[z];
+        std::cout << " " << profiler_zone_name(z) << " " << zone_total / count;
+    }
+    std::cout << std::endl;
+#endif
+}
+
+// Include guard HEADLESS
+#endif // HEADLESS
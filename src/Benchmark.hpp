@@ -0,0 +1,82 @@
+#pragma once
+
+// Headless benchmark harness (host only).
+//
+// Drives the real main loop without a window: key presses come from a
+// deterministic script, delta-time is fixed and every frame is timed.
+// Build with "make headless" and run from the repository root:
+//   ./dist/headless --frames 600 --render-mode 3
+//
+// Record & replay (see InputRecord.hpp):
+//   ./dist/headless --record run.rec                       (record the script)
+//   ./dist/headless --replay run.rec --checksums a.txt     (build A)
+//   ./dist/headless --replay run.rec --verify a.txt        (build B, stops at first difference)
+//
+// Golden images (see Golden.hpp):
+//   ./dist/headless --golden-write DIR / --golden-check DIR
+
+#ifdef HEADLESS
+
+#include <cstdint>
+
+struct BenchConfig
+{
+    uint32_t frames;      // Frames to run before exiting
+    float    dt;          // Fixed delta-time (seconds) fed to the car update
+    bool     dt_override; // dt given explicitly (replay ignores recorded dt)
+    int      render_mode; // Initial car RENDER_MODES value
+
+    const char* record_path;   // Write inputs to this recording
+    const char* replay_path;   // Read inputs from this recording instead of script
+    const char* checksum_path; // Write per-frame checksums
+    const char* verify_path;   // Compare per-frame checksums against this file
+
+    const char* map_path;      // Map to load instead of python/little_map.map
+    float       far_distance;  // Renderer far plane
+    bool        z_buffer;      // Depth buffer instead of sorting
+    unsigned    threads;       // job_system threads, 0 is one per core
+    bool        pipeline;      // Simulate on a thread of its own (see Pipeline.hpp)
+
+    const char* golden_write_dir; // Render golden poses and save them here
+    const char* golden_check_dir; // Render golden poses and compare against these
+    int         golden_tolerance;  // Max per-channel difference of a matching pixel
+    uint32_t    golden_max_pixels; // Pixels allowed to exceed the tolerance
+};
+
+// Keys held down during one frame
+struct BenchInput
+{
+    bool accelerate;
+    bool brake;
+    bool turn_left;
+    bool turn_right;
+    bool boost;
+    bool render_mode;    // Render mode cycle key
+    bool camera_preset;  // Camera preset cycle key
+};
+
+// Returns false (after printing usage) if arguments were invalid
+bool bench_parse_args(int argc, const char* argv[], BenchConfig& config);
+
+// Opens checksum files given in config. Returns false on error.
+bool bench_open(const BenchConfig& config);
+
+// Writes and/or verifies the checksums of one frame.
+// Returns false at the first frame that differs from the verify file.
+bool bench_checksum_frame(uint32_t frame, uint32_t car_checksum, uint32_t screen_checksum);
+
+// Scripted input for given frame. Same frame always gives same keys.
+BenchInput bench_script_input(uint32_t frame);
+
+// Call around init_map()
+void bench_load_begin();
+void bench_load_end();
+
+// Call around everything that belongs to one frame
+void bench_frame_begin();
+void bench_frame_end();
+
+// Print frame time distribution and render statistics to stdout
+void bench_report(const BenchConfig& config, unsigned model_count, uint32_t scratch_high_water);
+
+#endif // HEADLESS
@@ -2,6 +2,10 @@
 
 #include "RenderUtils.hpp"
 
+#include "InputRecord.hpp"
+
+#include "DirtyRects.hpp"
+
 #ifndef PC
 #   include <sdk/calc/calc.hpp>
 #else
@@ -61,6 +65,7 @@ inline void drawSpeedIndicator(const Fix16 speed, const color_t colorr)
     const auto y2 = offset_y;
     line(x1, y1,   x2, y2,   colorr );
     line(x1, y1+1, x2, y2+1, colorr );
+    dirty_rects.addLine(x1, y1, x2, y2+1);
 #else
     const auto needle_width = 30.0f;
     const auto edge_offset = 20;
@@ -74,6 +79,7 @@ inline void drawSpeedIndicator(const Fix16 speed, const color_t colorr)
     const auto y2 = offset_y;
     line(x1, y1,   x2, y2,   colorr );
     line(x1, y1+1, x2, y2+1, colorr );
+    dirty_rects.addLine(x1, y1, x2, y2+1);
 #endif
 }
 
@@ -96,18 +102,14 @@ inline void drawBoostIndicator(const Fix16 boostLeft, const color_t colorr)
     // Border
     line( x1_full,  y1-2,     x2_full,   y2-2, color(0,0,125));
     line( x1_full,  y1+3,     x2_full,   y2+3, color(0,0,125));
+    // Border encloses the amount
+    dirty_rects.addLine(x1_full, y1-2, x2_full, y2+3);
 #else
 #   error "TODO BOOST INDICATOR PORTRAIT MODE"
 #endif
 }
 
-void Car::clear_UI()
-{
-    drawSpeedIndicator(speed,        FILL_SCREEN_COLOR);
-    drawBoostIndicator(boostLeft_UI, FILL_SCREEN_COLOR);
-}
-
-void Car::draw_UI()
+void Car::draw_UI() const
 {
     // Draw speed indicatior
     drawSpeedIndicator(speed,        color(178,0,0));
@@ -121,6 +123,21 @@ void Car::add_boost(Fix16 boostTime)
         boostLeft = MAX_BOOST_TIME;
 }
 
+uint32_t Car::state_checksum() const
+{
+    // Hash raw values one by one (hashing the object itself would include padding)
+    const fix16_t state[] = {
+        pos.x.value, pos.y.value,
+        vel.x.value, vel.y.value,
+        acc.x.value, acc.y.value,
+        rot.value, wheelNorm.value,
+        speed.value, speed_perc.value,
+        boostLeft.value, boostLeft_UI.value,
+        (fix16_t) using_boost
+    };
+    return fnv1a_32(state, sizeof(state));
+}
+
 void Car::update(
     const Fix16 dt,
     bool accelerate,
@@ -244,4 +261,67 @@ void Car::update(
         boostLeft_UI = boostLeft;
     }
 
-}
\ No newline at end of file
+}
+
+// ~~~~~~~~~~~~~~~~ Camera following the car ~~~~~~~~~~~~~~~~
+
+void apply_camera_preset(
+    uint16_t camera_position_preset,
+    fix16_vec3& camera_pos, fix16_vec2& camera_rot, Fix16& FOV,
+    Fix16& camera_car_distance
+) {
+    if (camera_position_preset == 0){
+        FOV = 150.0f;
+        camera_car_distance = 9.0f;
+        camera_pos.y        = -CAMERA_HEIGHT;
+        camera_rot.y        = 0.1f;
+    }
+    else if (camera_position_preset == 1){
+        FOV = 150.0f;
+        camera_car_distance = 6.0f;
+        camera_pos.y        = -CAMERA_HEIGHT-6.0f;
+        camera_rot.y        = 0.1f;
+    }
+    else if (camera_position_preset == 2){
+        FOV = 130.0f;
+        camera_car_distance = 3.0f;
+        camera_pos.y        = -CAMERA_HEIGHT-15.0f;
+        camera_rot.y        = 0.5f;
+    }
+    else if (camera_position_preset == 3){
+        FOV = 120.0f;
+        camera_car_distance = 1.0f;
+        camera_pos.y        = -CAMERA_HEIGHT-21.0f;
+        camera_rot.y        = 0.5f;
+    }
+}
+
+void update_car_frame(
+    Car& car, Fix16 dt,
+    bool accelerate, bool car_break, bool turn_left, bool turn_right, bool boost,
+    Fix16 camera_car_distance, fix16_vec3& camera_pos, fix16_vec2& camera_rot,
+    Fix16& car_model_rot_x
+) {
+    dt = dt / Fix16((int16_t) CAR_UPDATE_SUBSTEPS);
+    for (uint16_t i=0; i<CAR_UPDATE_SUBSTEPS; i++)
+    {
+        car.update(dt, accelerate, car_break, turn_left, turn_right, boost);
+
+        // Effect: Camera position lagging behind to give sense of speed
+        auto cam_forward = calculate2DForward(camera_rot);
+        const Fix16 cam_targ_x = car.get_pos().x - (cam_forward.x * camera_car_distance);
+        const Fix16 cam_targ_y = car.get_pos().y - (cam_forward.y * camera_car_distance);
+        camera_pos.x = easeInLinear(camera_pos.x, cam_targ_x, dt, 5.0f);
+        camera_pos.z = easeInLinear(camera_pos.z, cam_targ_y, dt, 5.0f);
+
+        // Effect: Camera rotation slightly lagging behind
+        camera_rot.x = easeInLinear(camera_rot.x, car.get_rot(),
+            dt,
+            Fix16(3.5f)
+        );
+
+        // Update car model rotation
+        // Effect: Slight delay in actual rotation makes it look both smoother and more "real"
+        car_model_rot_x = easeInLinear(car_model_rot_x, car.get_rot() + Fix16(fix16_pi), dt, 5.5f);
+    }
+}
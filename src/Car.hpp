@@ -18,6 +18,13 @@
 #define VEL_FRICTION       4.0f
 #define BREAK_FRICTION    40.0f
 
+// Car::update() calls per frame. Fixed point math gets inaccurate when
+// delta time gets too large.
+#define CAR_UPDATE_SUBSTEPS 4
+
+#define CAMERA_HEIGHT 10.0f
+#define CAMERA_POSITION_PRESET_COUNT 4
+
 // Actual car logic is in 2d, just the graphics is in 3D
 
 class Car
@@ -50,8 +57,8 @@ public:
         bool boost
     );
 
-    void clear_UI();
-    void draw_UI();
+    // Reports what it draws to dirty_rects, cleared by Renderer::screen_flush()
+    void draw_UI() const;
 
     fix16_vec2& get_pos();
     Fix16& get_rot();
@@ -61,6 +68,25 @@ public:
 
     void add_boost(Fix16 boostTime);
 
+    // Hash of the simulation state (used to detect replay divergence)
+    uint32_t state_checksum() const;
+
     Car(/* args */);
     ~Car();
 };
+
+// Camera height, tilt, FOV and distance behind the car of given preset
+void apply_camera_preset(
+    uint16_t camera_position_preset,
+    fix16_vec3& camera_pos, fix16_vec2& camera_rot, Fix16& FOV,
+    Fix16& camera_car_distance
+);
+
+// One frame of car physics in CAR_UPDATE_SUBSTEPS sub-steps of dt. Camera and
+// car model rotation ease after the car in every sub-step.
+void update_car_frame(
+    Car& car, Fix16 dt,
+    bool accelerate, bool car_break, bool turn_left, bool turn_right, bool boost,
+    Fix16 camera_car_distance, fix16_vec3& camera_pos, fix16_vec2& camera_rot,
+    Fix16& car_model_rot_x
+);
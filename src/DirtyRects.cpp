@@ -0,0 +1,141 @@
+#include "DirtyRects.hpp"
+
+#include "RenderStats.hpp"
+
+DirtyRects dirty_rects;
+
+static inline int32_t area(const DirtyRect& r)
+{
+    return (int32_t) (r.x1 - r.x0) * (r.y1 - r.y0);
+}
+
+static inline bool overlaps(const DirtyRect& a, const DirtyRect& b)
+{
+    return a.x0 < b.x1 && b.x0 < a.x1 && a.y0 < b.y1 && b.y0 < a.y1;
+}
+
+static inline DirtyRect unite(const DirtyRect& a, const DirtyRect& b)
+{
+    return {
+        a.x0 < b.x0 ? a.x0 : b.x0, a.y0 < b.y0 ? a.y0 : b.y0,
+        a.x1 > b.x1 ? a.x1 : b.x1, a.y1 > b.y1 ? a.y1 : b.y1
+    };
+}
+
+// Pixels the union clears that neither a nor b needs
+static inline int32_t mergeWaste(const DirtyRect& a, const DirtyRect& b)
+{
+    int32_t overlap = 0;
+    if (overlaps(a, b)) {
+        const int32_t w = (a.x1 < b.x1 ? a.x1 : b.x1) - (a.x0 > b.x0 ? a.x0 : b.x0);
+        const int32_t h = (a.y1 < b.y1 ? a.y1 : b.y1) - (a.y0 > b.y0 ? a.y0 : b.y0);
+        overlap = w * h;
+    }
+    return area(unite(a, b)) - area(a) - area(b) + overlap;
+}
+
+// Adds the parts of r outside rects[from, end). Pieces of one cut are
+// disjoint, so appended pieces never need to be checked against each other.
+// Returns false if the set ran full.
+bool DirtyRects::cut(DirtyRect r, unsigned from, unsigned end)
+{
+    for (unsigned i = from; i < end; i++) {
+        const DirtyRect o = rects[i];
+        if (!overlaps(o, r))
+            continue;
+        const int16_t mid_y0 = r.y0 > o.y0 ? r.y0 : o.y0;
+        const int16_t mid_y1 = r.y1 < o.y1 ? r.y1 : o.y1;
+        // Full width bands above and below o, then left and right of it
+        const DirtyRect pieces[4] = {
+            {r.x0, r.y0,   r.x1, o.y0},
+            {r.x0, o.y1,   r.x1, r.y1},
+            {r.x0, mid_y0, o.x0, mid_y1},
+            {o.x1, mid_y0, r.x1, mid_y1}
+        };
+        for (const DirtyRect& p : pieces) {
+            if (p.x0 < p.x1 && p.y0 < p.y1 && !cut(p, i + 1, end))
+                return false;
+        }
+        return true;
+    }
+    if (count == DIRTY_RECT_MAX)
+        return false;
+    rects[count++] = r;
+    return true;
+}
+
+void DirtyRects::add(int x0, int y0, int x1, int y1)
+{
+    if (x0 < 0)        x0 = 0;
+    if (y0 < 0)        y0 = 0;
+    if (x1 > SCREEN_X) x1 = SCREEN_X;
+    if (y1 > SCREEN_Y) y1 = SCREEN_Y;
+    if (x0 >= x1 || y0 >= y1)
+        return;
+    DirtyRect r = {(int16_t) x0, (int16_t) y0, (int16_t) x1, (int16_t) y1};
+
+    // Merge while it is cheap
+    for (unsigned i = 0; i < count; ) {
+        if (mergeWaste(rects[i], r) <= DIRTY_RECT_MERGE_COST) {
+            r = unite(rects[i], r);
+            remove(i);
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+
+    const unsigned first_piece = count;
+    if (cut(r, 0, count))
+        return;
+
+    // Full: drop the pieces, r takes over everything it overlaps and then
+    // the rect it grows least until there is room
+    count = first_piece;
+    for (;;) {
+        unsigned i = 0;
+        while (i < count && !overlaps(rects[i], r))
+            i++;
+        if (i == count) {
+            if (count < DIRTY_RECT_MAX)
+                break;
+            int32_t best_waste = INT32_MAX;
+            for (unsigned j = 0; j < count; j++) {
+                const int32_t waste = mergeWaste(rects[j], r);
+                if (waste < best_waste) {
+                    best_waste = waste;
+                    i = j;
+                }
+            }
+        }
+        r = unite(rects[i], r);
+        remove(i);
+    }
+    rects[count++] = r;
+}
+
+void DirtyRects::addLine(int x1, int y1, int x2, int y2)
+{
+    add(
+        (x1 < x2 ? x1 : x2),     (y1 < y2 ? y1 : y2),
+        (x1 > x2 ? x1 : x2) + 1, (y1 > y2 ? y1 : y2) + 1
+    );
+}
+
+void DirtyRects::clear(color_t color)
+{
+    for (unsigned i = 0; i < count; i++) {
+        const DirtyRect& r = rects[i];
+        const int w = r.x1 - r.x0;
+        for (int y = r.y0; y < r.y1; y++)
+            fillSpan(screen_row(y) + r.x0, w, color);
+        // Depth only exists where models were drawn, but the rects are disjoint
+        // so clearing it under every rect is still once per pixel
+        if (zbuffer) {
+            for (int y = r.y0; y < r.y1; y++)
+                fillSpan(zbuffer + y * SCREEN_X + r.x0, w, 0);
+        }
+        RENDER_STATS_ADD(pixels_cleared, area(r));
+    }
+    reset();
+}
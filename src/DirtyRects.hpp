@@ -0,0 +1,54 @@
+#pragma once
+
+// Screen areas drawn since the last clear.
+//
+// Every draw path reports the rectangle it wrote to (dirty_rects.add) and
+// Renderer::screen_flush() clears only those with dirty_rects.clear(). Rects
+// are kept disjoint so every pixel is cleared at most once per frame:
+//  - A new rect is merged with an existing one when their union costs at most
+//    DIRTY_RECT_MERGE_COST pixels more than clearing both (a rect that
+//    contains the other costs nothing). The union may reach further rects,
+//    so merging repeats until nothing is cheap anymore.
+//  - Otherwise the parts already covered by other rects are cut away and the
+//    remaining pieces (up to 4 per overlap) are added.
+//  - When the set is full (DIRTY_RECT_MAX) the rect swallows what it overlaps
+//    and merges with the rect it grows least.
+
+#include "RenderUtils.hpp"
+
+#include <stdint.h>
+
+// Half-open: x0 <= x < x1, y0 <= y < y1
+struct DirtyRect {
+    int16_t x0, y0, x1, y1;
+};
+
+class DirtyRects {
+private:
+    DirtyRect rects[DIRTY_RECT_MAX];
+    unsigned count;
+
+    void remove(unsigned i) { rects[i] = rects[--count]; }
+    bool cut(DirtyRect r, unsigned from, unsigned end);
+
+public:
+    DirtyRects() : count(0) { }
+
+    // Clamped to the screen, empty rects are ignored
+    void add(int x0, int y0, int x1, int y1);
+    // Bounding box of a line(), end points included
+    void addLine(int x1, int y1, int x2, int y2);
+
+    // Fills every rect with color, zeroes zbuffer under them if allocated
+    // and empties the set
+    void clear(color_t color);
+
+    // Empties the set without clearing anything
+    void reset() { count = 0; }
+
+    unsigned get_count() const { return count; }
+    const DirtyRect& get_rect(unsigned i) const { return rects[i]; }
+};
+
+// Defined in DirtyRects.cpp
+extern DirtyRects dirty_rects;
@@ -62,6 +62,11 @@ public:
         return true;
     }
 
+    // Keeps the capacity
+    void clear() {
+        size = 0;
+    }
+
     unsigned int getSize() const {
         return size;
     }
@@ -0,0 +1,83 @@
+#pragma once
+
+// Bump allocator for per-frame render scratch buffers.
+//
+// One malloc'd block is handed out in 4 byte aligned pieces. Nothing is freed
+// individually: rewind() to a mark() drops everything allocated after it and
+// reset() drops everything. The block only grows in reserve(), which is only
+// allowed while nothing is allocated (pointers must stay valid), so callers
+// reserve the largest need up front and steady state does no heap allocation.
+
+#ifndef PC
+#   include <sdk/os/mem.h>
+#else
+#   include <cstdlib>
+#endif
+
+#include <stdint.h>
+
+// SH4 needs aligned 32b accesses
+#define FRAME_ARENA_ALIGN 4
+
+class FrameArena {
+private:
+    uint8_t* buffer;
+    uint32_t capacity;
+    uint32_t used;
+    uint32_t high_water;
+
+public:
+    FrameArena() : buffer(nullptr), capacity(0), used(0), high_water(0) { }
+
+    // Grows block to at least bytes. Only while empty.
+    bool reserve(uint32_t bytes)
+    {
+        if (bytes <= capacity)
+            return true;
+        if (used != 0)
+            return false;
+        uint8_t* new_buffer = static_cast<uint8_t*>(malloc(bytes));
+        if (!new_buffer)
+            return false;
+        if (buffer)
+            free(buffer);
+        buffer = new_buffer;
+        capacity = bytes;
+        return true;
+    }
+
+    // Returns nullptr if the block is too small (reserve first)
+    template <typename T>
+    T* alloc(uint32_t count)
+    {
+        const uint32_t bytes = size_of<T>(count);
+        if (used + bytes > capacity)
+            return nullptr;
+        T* ptr = reinterpret_cast<T*>(buffer + used);
+        used += bytes;
+        if (used > high_water)
+            high_water = used;
+        return ptr;
+    }
+
+    // Bytes needed by alloc<T>(count), for sizing reserve()
+    template <typename T>
+    static uint32_t size_of(uint32_t count)
+    {
+        return (count * sizeof(T) + FRAME_ARENA_ALIGN - 1) & ~(uint32_t) (FRAME_ARENA_ALIGN - 1);
+    }
+
+    uint32_t mark() const { return used; }
+    void rewind(uint32_t mark) { used = mark; }
+    void reset() { used = 0; }
+
+    uint32_t get_capacity() const { return capacity; }
+    // Most bytes in use at once since creation
+    uint32_t get_high_water() const { return high_water; }
+
+    ~FrameArena()
+    {
+        if (buffer)
+            free(buffer);
+    }
+};
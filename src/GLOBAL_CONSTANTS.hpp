@@ -24,24 +24,44 @@
 // Landscape or Portrait mode (portrait mode may have missing features at this point)
 #define LANDSCAPE_MODE
 
-// 3 screen clearing options:
-//  PER_MODEL_CLEAR   -> Bounding box per model (Best with caveat of maybe ending up with lots of overlaping clears which may end up slowing down actually)
-//  (none)            -> Bounding box created using all models
-//  CLEAR_FULL_SCREEN -> Always clears full screen
-//
-// Either making a global clearing bound box or per model.
-// Per model works well if there are lots of tiny objects
-// with lots of space inbetween. However if they start to over-lap alot then
-// we end up clearing same location multiple times which wastes time.
-// Hence option to clear per model.
-#   define PER_MODEL_CLEAR
-// When defined then full screen will be cleared instead of bound box based clearing
-// -> Slowest option
-// #   define CLEAR_FULL_SCREEN
+// Screen clearing: draw paths report the rectangles they drew to and only
+// those are cleared (DirtyRects). Overlapping rects are merged when the union
+// clears at most DIRTY_RECT_MERGE_COST pixels more than both, otherwise the
+// overlap is cut away, so no pixel is cleared twice. A merge saves the
+// per-rect and per-row overhead of a separate clear.
+#define DIRTY_RECT_MAX        32
+#define DIRTY_RECT_MERGE_COST 256
 
 #define SCREEN_X 320
 #define SCREEN_Y 528
 
+// Models further than this from the camera are not drawn (Renderer::get_farDistance)
+#define FAR_DISTANCE_DEFAULT 400.0f
+
+// Faces and lines are clipped to this distance in front of the camera
+#define NEAR_DISTANCE 0.5f
+// Projected vertices may be this many pixels off screen before faces and
+// lines are clipped to it, the rest is cut by the rasterizer/setPixel
+#define GUARD_BAND 100
+
+// Textured triangles are binned into square screen tiles of
+// 1 << RASTER_TILE_SIZE_LOG2 pixels and rasterized tile by tile (TileBinner)
+#define RASTER_TILE_SIZE_LOG2 5
+
+// PC runs model transforms and screen tiles as jobs on up to this many threads (JobSystem)
+#define JOB_THREADS_MAX 16
+
+// Depth buffer instead of sorting faces and models (painter's algorithm).
+// Costs an uint16_t per pixel, allocated when first used.
+// Renderer::get_zBuffer() switches at run time.
+#define Z_BUFFER_DEFAULT false
+// Depth buffer stores Z_BUFFER_NEAR/z in 16 bits: anything closer than this ties
+#define Z_BUFFER_NEAR 1.0f
+
+// Power of two textures (and mip levels down to 4x4) are stored in 4x4 texel
+// tiles and addressed with masks instead of clamping (see MipLevel)
+#define TILED_TEXTURES
+
 #ifdef PC
 #   define UNIVERSIAL_FILE_READ O_RDONLY
 #else
@@ -0,0 +1,246 @@
+#ifdef HEADLESS
+// Include guard HEADLESS
+
+#include "Golden.hpp"
+
+#include "PC_SDL_screen.hpp"
+
+#include <cstdio>
+#include <cstdlib>  // malloc, free
+#include <iostream>
+#include <sys/stat.h> // mkdir
+
+extern uint32_t screenPixels[SCREEN_X * SCREEN_Y];
+
+struct GoldenPose
+{
+    const char* name;
+    fix16_vec3  camera_pos;
+    fix16_vec2  camera_rot;
+    Fix16       FOV;
+};
+
+// Car starts at the origin facing PI. Camera height is negative y.
+static const GoldenPose golden_poses[] = {
+    // Same as camera presets 0 and 2 behind the car
+    {"behind",   {0.0f, -10.0f,  9.0f}, {Fix16(fix16_pi), 0.1f}, 150.0f},
+    {"above",    {0.0f, -25.0f,  3.0f}, {Fix16(fix16_pi), 0.5f}, 130.0f},
+    // Car from the side, walls behind it
+    {"side",     {-12.0f, -8.0f, 0.0f}, {Fix16(fix16_pi / 2), 0.1f}, 150.0f},
+    // High up looking over the map walls
+    {"overview", {0.0f, -60.0f, 40.0f}, {Fix16(fix16_pi), 0.9f}, 120.0f},
+};
+
+#define GOLDEN_POSE_COUNT (sizeof(golden_poses) / sizeof(golden_poses[0]))
+
+// ~~~~~~~~~~~~~~~~ PPM (P6) ~~~~~~~~~~~~~~~~
+
+static void unpack_rgb(uint32_t pixel, uint8_t* rgb)
+{
+    rgb[0] = (pixel >> 16) & 0xFF;
+    rgb[1] = (pixel >>  8) & 0xFF;
+    rgb[2] = (pixel >>  0) & 0xFF;
+}
+
+static bool write_ppm(const char* path, const uint8_t* rgb)
+{
+    FILE* f = fopen(path, "wb");
+    if (!f)
+        return false;
+    fprintf(f, "P6\n%d %d\n255\n", SCREEN_X, SCREEN_Y);
+    const bool ok = fwrite(rgb, 3, SCREEN_X * SCREEN_Y, f) == SCREEN_X * SCREEN_Y;
+    fclose(f);
+    return ok;
+}
+
+// ~~~~~~~~~~~~~~~~ Run-length coded references ~~~~~~~~~~~~~~~~
+
+// Committed references are <name>.rle: a "GOLDEN-RLE\n<w> <h>\n" header and
+// packets of pixels in RGB order. A packet byte below 128 is followed by
+// byte + 1 literal pixels, from 128 up it is followed by one pixel repeated
+// byte - 126 times. Same pixels as the PPM in a few percent of its size.
+
+static bool same_pixel(const uint8_t* rgb, int a, int b)
+{
+    return rgb[a * 3] == rgb[b * 3] && rgb[a * 3 + 1] == rgb[b * 3 + 1] && rgb[a * 3 + 2] == rgb[b * 3 + 2];
+}
+
+static bool write_rle(const char* path, const uint8_t* rgb)
+{
+    FILE* f = fopen(path, "wb");
+    if (!f)
+        return false;
+    fprintf(f, "GOLDEN-RLE\n%d %d\n", SCREEN_X, SCREEN_Y);
+    const int count = SCREEN_X * SCREEN_Y;
+    int i = 0;
+    while (i < count) {
+        int run = 1;
+        while (i + run < count && run < 129 && same_pixel(rgb, i, i + run))
+            run++;
+        if (run > 1) {
+            fputc(128 + run - 2, f);
+            fwrite(rgb + i * 3, 3, 1, f);
+            i += run;
+            continue;
+        }
+        // Literals up to the next run of two
+        int literals = 1;
+        while (i + literals < count && literals < 128
+            && !(i + literals + 1 < count && same_pixel(rgb, i + literals, i + literals + 1)))
+            literals++;
+        fputc(literals - 1, f);
+        fwrite(rgb + i * 3, 3, literals, f);
+        i += literals;
+    }
+    return fclose(f) == 0;
+}
+
+static bool read_rle(const char* path, uint8_t* rgb)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return false;
+    int w, h;
+    bool ok = fscanf(f, "GOLDEN-RLE %d %d", &w, &h) == 2
+        && w == SCREEN_X && h == SCREEN_Y
+        && fgetc(f) != EOF; // Single whitespace after header
+    const int count = SCREEN_X * SCREEN_Y;
+    int i = 0;
+    while (ok && i < count) {
+        const int packet = fgetc(f);
+        if (packet == EOF) {
+            ok = false;
+        } else if (packet < 128) {
+            const int literals = packet + 1;
+            ok = i + literals <= count && fread(rgb + i * 3, 3, literals, f) == (size_t) literals;
+            i += literals;
+        } else {
+            const int run = packet - 126;
+            ok = i + run <= count && fread(rgb + i * 3, 3, 1, f) == 1;
+            for (int r = 1; ok && r < run; r++) {
+                rgb[(i + r) * 3]     = rgb[i * 3];
+                rgb[(i + r) * 3 + 1] = rgb[i * 3 + 1];
+                rgb[(i + r) * 3 + 2] = rgb[i * 3 + 2];
+            }
+            i += run;
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+// mkdir -p
+static void make_dirs(const char* dir)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s", dir);
+    for (char* c = path + 1; *c; c++) {
+        if (*c != '/')
+            continue;
+        *c = '\0';
+        mkdir(path, 0755);
+        *c = '/';
+    }
+    mkdir(path, 0755);
+}
+
+// ~~~~~~~~~~~~~~~~ Compare ~~~~~~~~~~~~~~~~
+
+// Returns the count of pixels where any channel differs more than tolerance.
+// diff gets the dimmed actual image with mismatching pixels in red.
+static uint32_t compare_images(const uint8_t* actual, const uint8_t* reference, uint8_t* diff, int tolerance)
+{
+    uint32_t mismatches = 0;
+    for (int i = 0; i < SCREEN_X * SCREEN_Y; i++) {
+        const uint8_t* a = actual    + i * 3;
+        const uint8_t* r = reference + i * 3;
+        bool mismatch = false;
+        for (int c = 0; c < 3; c++)
+            mismatch |= abs((int) a[c] - (int) r[c]) > tolerance;
+
+        uint8_t* d = diff + i * 3;
+        if (mismatch) {
+            mismatches++;
+            d[0] = 255; d[1] = 0; d[2] = 0;
+        } else {
+            d[0] = a[0] / 4; d[1] = a[1] / 4; d[2] = a[2] / 4;
+        }
+    }
+    return mismatches;
+}
+
+bool golden_run(const BenchConfig& config, Renderer& renderer, Model* car_model)
+{
+    const bool write = config.golden_write_dir != nullptr;
+    const char* dir  = write ? config.golden_write_dir : config.golden_check_dir;
+    if (write)
+        make_dirs(dir);
+
+    uint8_t* actual    = (uint8_t*) malloc(SCREEN_X * SCREEN_Y * 3);
+    uint8_t* reference = (uint8_t*) malloc(SCREEN_X * SCREEN_Y * 3);
+    uint8_t* diff      = (uint8_t*) malloc(SCREEN_X * SCREEN_Y * 3);
+
+    unsigned failed = 0;
+    char path[512];
+    char name[64];
+    for (unsigned p = 0; p < GOLDEN_POSE_COUNT; p++) {
+        for (uint16_t mode = 0; mode < RENDER_MODE_COUNT; mode++) {
+            const GoldenPose& pose = golden_poses[p];
+            snprintf(name, sizeof(name), "%s_mode%u", pose.name, (unsigned) mode);
+
+            renderer.get_camera_pos() = pose.camera_pos;
+            renderer.get_camera_rot() = pose.camera_rot;
+            renderer.get_FOV()        = pose.FOV;
+            renderer.camera_move_dirty = true;
+            car_model->render_mode = mode;
+
+            // Every image starts from a clean screen
+            fillScreen(FILL_SCREEN_COLOR);
+            renderer.update();
+            for (int i = 0; i < SCREEN_X * SCREEN_Y; i++)
+                unpack_rgb(screenPixels[i], actual + i * 3);
+            renderer.screen_flush();
+
+            snprintf(path, sizeof(path), "%s/%s.rle", dir, name);
+            if (write) {
+                if (!write_rle(path, actual)) {
+                    std::cout << "Could not write " << path << std::endl;
+                    failed++;
+                }
+                continue;
+            }
+            if (!read_rle(path, reference)) {
+                std::cout << "FAIL " << name << ": could not read " << path << std::endl;
+                failed++;
+                continue;
+            }
+            const uint32_t mismatches = compare_images(actual, reference, diff, config.golden_tolerance);
+            if (mismatches > config.golden_max_pixels) {
+                std::cout << "FAIL " << name << ": " << mismatches << " pixels differ" << std::endl;
+                snprintf(path, sizeof(path), "%s/%s.actual.ppm", dir, name);
+                write_ppm(path, actual);
+                snprintf(path, sizeof(path), "%s/%s.diff.ppm", dir, name);
+                write_ppm(path, diff);
+                snprintf(path, sizeof(path), "%s/%s.reference.ppm", dir, name);
+                write_ppm(path, reference);
+                failed++;
+            } else {
+                std::cout << "ok   " << name << " (" << mismatches << " pixels differ)" << std::endl;
+            }
+        }
+    }
+
+    free(actual);
+    free(reference);
+    free(diff);
+
+    const unsigned total = GOLDEN_POSE_COUNT * RENDER_MODE_COUNT;
+    if (write)
+        std::cout << "Wrote " << total - failed << "/" << total << " golden images to " << dir << std::endl;
+    else
+        std::cout << total - failed << "/" << total << " golden images match" << std::endl;
+    return failed == 0;
+}
+
+// Include guard HEADLESS
+#endif // HEADLESS
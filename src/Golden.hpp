@@ -0,0 +1,24 @@
+#pragma once
+
+// Golden image regression check (headless host build only).
+//
+// Renders a fixed set of camera poses, with the car in every RENDER_MODE
+// and the map walls in view, into the off-screen framebuffer. Each frame
+// is saved to or compared against a run-length coded reference in the given
+// directory. The references of the current renderer are in tests/golden:
+//   ./dist/headless --golden-check tests/golden   (after changing the renderer)
+//   ./dist/headless --golden-write tests/golden   (when pixels change on purpose)
+// A channel may differ by --golden-tolerance and up to --golden-max-pixels
+// pixels may exceed it. For every image that fails, <name>.actual.ppm,
+// <name>.diff.ppm and <name>.reference.ppm are written next to the reference.
+// Mismatching pixels are red in the diff and everything else is dimmed.
+
+#ifdef HEADLESS
+
+#include "Benchmark.hpp"
+#include "Renderer.hpp"
+
+// Returns false if any image differs (or could not be read/written)
+bool golden_run(const BenchConfig& config, Renderer& renderer, Model* car_model);
+
+#endif // HEADLESS
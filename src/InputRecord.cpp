@@ -0,0 +1,76 @@
+#ifdef PC
+// Include guard PC
+
+#include "InputRecord.hpp"
+
+#include <unistd.h>  // File open & close
+#include <fcntl.h>   // File open & close
+
+InputRecorder::InputRecorder()
+:   fd(-1)
+{
+}
+
+InputRecorder::~InputRecorder()
+{
+    close();
+}
+
+bool InputRecorder::open(const char* path)
+{
+    close();
+    fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    const uint32_t header[2] = {INPUT_RECORD_MAGIC, INPUT_RECORD_VERSION};
+    if (::write(fd, header, sizeof(header)) != (ssize_t) sizeof(header)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void InputRecorder::write(const InputFrame& frame)
+{
+    if (fd < 0)
+        return;
+    if (::write(fd, &frame, sizeof(InputFrame)) != (ssize_t) sizeof(InputFrame))
+        close();
+}
+
+void InputRecorder::close()
+{
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+}
+
+bool InputRecorder::is_open() const
+{
+    return fd >= 0;
+}
+
+bool load_input_recording(const char* path, DynamicArray<InputFrame>& frames)
+{
+    int fd = open(path, UNIVERSIAL_FILE_READ);
+    if (fd < 0)
+        return false;
+
+    uint32_t header[2] = {0, 0};
+    if (read(fd, header, sizeof(header)) != (ssize_t) sizeof(header) ||
+        header[0] != INPUT_RECORD_MAGIC || header[1] != INPUT_RECORD_VERSION)
+    {
+        close(fd);
+        return false;
+    }
+
+    InputFrame frame;
+    while (read(fd, &frame, sizeof(InputFrame)) == (ssize_t) sizeof(InputFrame))
+        frames.push_back(frame);
+
+    close(fd);
+    return true;
+}
+
+// Include guard PC
+#endif // PC
@@ -0,0 +1,71 @@
+#pragma once
+
+// Input record & replay for the main loop.
+//
+// A recording is a small header ("CGWR" + version) followed by one
+// InputFrame per simulated frame. Replaying feeds the same inputs and
+// delta-times back, so two builds can be compared on identical workloads.
+
+#include "libfixmath/fix16.hpp"
+
+#include "DynamicArray.hpp"
+
+#define INPUT_RECORD_MAGIC   0x52574743 // "CGWR" (little endian)
+#define INPUT_RECORD_VERSION 1
+
+enum INPUT_KEYS : uint8_t {
+    INPUT_ACCELERATE = 1 << 0,
+    INPUT_BRAKE      = 1 << 1,
+    INPUT_TURN_LEFT  = 1 << 2,
+    INPUT_TURN_RIGHT = 1 << 3,
+    INPUT_BOOST      = 1 << 4
+};
+
+struct InputFrame
+{
+    fix16_t  dt;            // Delta-time of the frame (before sub-stepping)
+    uint8_t  keys;          // INPUT_KEYS bitmask
+    uint8_t  render_mode;   // Car model render mode
+    uint8_t  camera_preset; // Camera position preset
+    uint8_t  reserved;
+    uint32_t car_checksum;  // Car::state_checksum() after the frame update
+};
+
+#define FNV1A_32_SEED 2166136261u
+
+// FNV-1a hash. Pass previous result as hash to continue hashing.
+inline uint32_t fnv1a_32(const void* data, unsigned size, uint32_t hash = FNV1A_32_SEED)
+{
+    const uint8_t* bytes = (const uint8_t*) data;
+    for (unsigned i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+#ifdef PC
+// Include guard PC
+
+class InputRecorder
+{
+private:
+    int fd;
+
+public:
+    // Returns false if file could not be created
+    bool open(const char* path);
+    void write(const InputFrame& frame);
+    void close();
+    bool is_open() const;
+
+    InputRecorder();
+    ~InputRecorder();
+};
+
+// Reads whole recording into frames.
+// Returns false if file could not be read or is not a recording.
+bool load_input_recording(const char* path, DynamicArray<InputFrame>& frames);
+
+// Include guard PC
+#endif // PC
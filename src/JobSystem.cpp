@@ -0,0 +1,146 @@
+#ifdef PC
+// Include guard PC
+
+#include "JobSystem.hpp"
+
+JobSystem job_system;
+
+JobSystem::JobSystem()
+:   worker_count(0),
+    job(nullptr),
+    context(nullptr),
+    generation(0),
+    busy_workers(0),
+    stopping(false)
+{
+    for (unsigned i = 0; i < JOB_THREADS_MAX; i++) {
+        slices[i].begin = 0;
+        slices[i].end   = 0;
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    stopWorkers();
+}
+
+bool JobSystem::take(unsigned thread, unsigned& index)
+{
+    JobSlice& own = slices[thread];
+    {
+        std::lock_guard<std::mutex> lock(own.lock);
+        if (own.begin < own.end) {
+            index = own.begin++;
+            return true;
+        }
+    }
+    // Back half of another slice (a last single job is taken whole). Only
+    // one lock is held at a time, a thief stealing from this empty slice in
+    // between finds nothing.
+    const unsigned threads = worker_count + 1;
+    for (unsigned i = 1; i < threads; i++) {
+        JobSlice& victim = slices[(thread + i) % threads];
+        unsigned begin, end;
+        {
+            std::lock_guard<std::mutex> lock(victim.lock);
+            if (victim.begin >= victim.end)
+                continue;
+            begin = victim.begin + (victim.end - victim.begin) / 2;
+            end   = victim.end;
+            victim.end = begin;
+        }
+        {
+            std::lock_guard<std::mutex> lock(own.lock);
+            own.begin = begin + 1;
+            own.end   = end;
+        }
+        index = begin;
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::work(unsigned thread)
+{
+    unsigned index;
+    while (take(thread, index))
+        job(context, index);
+}
+
+void JobSystem::run(unsigned count, job_func_t job, void* context)
+{
+    const unsigned threads = worker_count + 1;
+    if (threads == 1 || count <= 1) {
+        for (unsigned i = 0; i < count; i++)
+            job(context, i);
+        return;
+    }
+
+    // Workers are all waiting, the mutex publishes this to them
+    this->job     = job;
+    this->context = context;
+    for (unsigned t = 0; t < threads; t++) {
+        slices[t].begin = (unsigned) ((uint64_t) count * t       / threads);
+        slices[t].end   = (unsigned) ((uint64_t) count * (t + 1) / threads);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        busy_workers = worker_count;
+        generation++;
+    }
+    work_start.notify_all();
+    work(0);
+
+    // Jobs taken by workers may still be running, and workers must not
+    // look at the slices anymore when the next run() fills them
+    std::unique_lock<std::mutex> lock(mutex);
+    work_done.wait(lock, [this] { return busy_workers == 0; });
+}
+
+// done_generation is the generation at spawn, a run right after must not be
+// mistaken for an old one
+void JobSystem::workerLoop(unsigned thread, uint32_t done_generation)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        work_start.wait(lock, [&] { return stopping || generation != done_generation; });
+        if (stopping)
+            return;
+        done_generation = generation;
+        lock.unlock();
+        work(thread);
+        lock.lock();
+        if (--busy_workers == 0)
+            work_done.notify_one();
+    }
+}
+
+void JobSystem::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_start.notify_all();
+    for (unsigned i = 0; i < worker_count; i++)
+        workers[i].join();
+    worker_count = 0;
+    stopping = false;
+}
+
+void JobSystem::set_threads(unsigned threads)
+{
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads < 1)               threads = 1;
+    if (threads > JOB_THREADS_MAX) threads = JOB_THREADS_MAX;
+
+    stopWorkers();
+    // Worker i runs slice i + 1, slice 0 belongs to the caller of run()
+    for (unsigned i = 0; i + 1 < threads; i++)
+        workers[i] = std::thread(&JobSystem::workerLoop, this, i + 1, generation);
+    worker_count = threads - 1;
+}
+
+// Include guard PC
+#endif // PC
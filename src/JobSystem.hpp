@@ -0,0 +1,80 @@
+#pragma once
+
+// Work-stealing job system (host build only).
+//
+// run(count, job, context) calls job(context, index) once for every index in
+// [0, count), spread over all threads with the calling one included, and
+// returns when every call is done. Jobs of one run must not depend on each
+// other and run() must not be called from inside a job.
+//
+// Every thread starts with an equal slice of consecutive indices and takes
+// them from the front, so neighbouring jobs (vertex ranges of one model,
+// screen tiles in one row) mostly stay on one thread. A thread whose slice
+// ran out steals the back half of the next slice that still has jobs.
+//
+// Which thread runs a job is not deterministic: jobs write to their own
+// outputs and the caller merges them in index order.
+
+#ifdef PC
+
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+
+typedef void (*job_func_t)(void* context, unsigned index);
+
+class JobSystem {
+private:
+    // Indices of one thread not taken yet, on its own cache line
+    struct alignas(64) JobSlice {
+        std::mutex lock;
+        unsigned begin;
+        unsigned end;
+    };
+
+    JobSlice slices[JOB_THREADS_MAX];
+    std::thread workers[JOB_THREADS_MAX - 1];
+    unsigned worker_count;
+
+    // Of the current run
+    job_func_t job;
+    void* context;
+
+    std::mutex mutex;
+    std::condition_variable work_start;
+    std::condition_variable work_done;
+    // Guarded by mutex
+    uint32_t generation; // Bumped by every run on more than one thread
+    unsigned busy_workers;
+    bool     stopping;
+
+    // Next index for thread from its own slice, or stolen. False when all are taken.
+    bool take(unsigned thread, unsigned& index);
+    void work(unsigned thread);
+    void workerLoop(unsigned thread, uint32_t done_generation);
+    void stopWorkers();
+
+public:
+    JobSystem();
+    ~JobSystem();
+
+    void run(unsigned count, job_func_t job, void* context);
+
+    // f(index) for a lambda or function object f
+    template <typename F>
+    void run(unsigned count, F& f)
+    {
+        run(count, [](void* context, unsigned index) { (*static_cast<F*>(context))(index); }, &f);
+    }
+
+    // Threads running jobs, the one calling run() included.
+    // Clamped to 1 - JOB_THREADS_MAX, 0 is one per hardware thread.
+    void set_threads(unsigned threads);
+    unsigned get_threads() const { return worker_count + 1; }
+};
+
+// Defined in JobSystem.cpp, one thread until set_threads()
+extern JobSystem job_system;
+
+#endif // PC
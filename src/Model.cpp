@@ -9,7 +9,9 @@
 #   include <stdlib.h> // For malloc, free
 #   include <string.h> // For memset
 #else
-#   include <SDL2/SDL.h>
+#   ifndef HEADLESS
+#       include <SDL2/SDL.h>
+#   endif
 #   include <iostream>
 #   include <unistd.h>  // File open & close
 #   include <fcntl.h>   // File open & close
@@ -27,6 +29,8 @@ Model::~Model()
         free(uv_coords);
         if(has_texture){
             free(gen_uv_tex);
+            free(face_normals);
+            free(face_light);
         }
     }
 }
@@ -36,16 +40,15 @@ Model::Model(
     char* ftexture,
     bool centerVertices
 ) : loaded_from_file(false),
-#ifdef PER_MODEL_CLEAR
-    bbox_max({0, 0}), bbox_min({0, 0}),
-#endif
     position({0.0f, 0.0f, 0.0f}), rotation({0.0f, 0.0f}), scale({1.0f,1.0f,1.0f}),
     vertices(nullptr), vertex_count(0),
     faces(nullptr), faces_count(0),
     has_texture(false),
-    gen_textureWidth(0), gen_textureHeight(0),
-    render_mode(0), color(0),
-    collision_extra(0)
+    gen_textureWidth(0), gen_textureHeight(0), mip_count(0),
+    face_normals(nullptr),
+    render_mode(0), cull_backfaces(true), frustum_culled(false), color(0),
+    encapsulating_radius(0.0f), collision_extra(0),
+    face_light(nullptr), face_light_valid(false)
 {
     loaded_from_file = this->load_from_binary_obj_file(fname, ftexture, centerVertices);
 }
@@ -64,16 +67,6 @@ fix16_vec3& Model::getScale_ref()
 {
     return this->scale;
 }
-#ifdef PER_MODEL_CLEAR
-int16_t_vec2& Model::getBoundBox_max()
-{
-    return this->bbox_max;
-}
-int16_t_vec2& Model::getBoundBox_min()
-{
-    return this->bbox_min;
-}
-#endif
 
 // Transform original model vertices to the geometric center
 void Model::_centerModel()
@@ -117,6 +110,7 @@ void Model::_scaleModel(Fix16 factor)
         vertices[i].y *= factor;
         vertices[i].z *= factor;
     }
+    _calculateFaceNormals();
 }
 
 // Transform raw model vertices to the geometric center
@@ -126,6 +120,8 @@ void Model::_scaleModel_Z(Fix16 factor)
     for (unsigned int  i = 0; i < vertex_count; ++i) {
         vertices[i].z *= factor;
     }
+    // Non-uniform scale turns the normals
+    _calculateFaceNormals();
 }
 
 // Scales model such that max distance between to furthest
@@ -161,6 +157,80 @@ void Model::_scaleModelTo(Fix16 maxWidth)
     _scaleModel(scaleFactor);
 }
 
+void Model::_calculateFaceNormals()
+{
+    if (!face_normals)
+        return;
+    for (unsigned f_id = 0; f_id < faces_count; ++f_id) {
+        auto face_norm = calculateNormal(
+            vertices[faces[f_id].First], vertices[faces[f_id].Second], vertices[faces[f_id].Third]
+        );
+        normalize_fix16_vec3(face_norm);
+        face_normals[f_id] = face_norm;
+    }
+    face_light_valid = false;
+}
+
+void Model::_generateMipChain()
+{
+    for (unsigned level = 1; level < mip_count; level++) {
+        const MipLevel& src = mip_levels[level - 1];
+        const MipLevel& dst = mip_levels[level];
+        // Odd sizes drop the last row/column, a side of 1 is not halved
+        const uint32_t step_x = src.width  > 1 ? 1 : 0;
+        const uint32_t step_y = src.height > 1 ? 1 : 0;
+        for (uint32_t y = 0; y < (uint32_t) dst.height; y++) {
+            for (uint32_t x = 0; x < (uint32_t) dst.width; x++) {
+                const uint32_t sx = x << step_x;
+                const uint32_t sy = y << step_y;
+                const texel_t t[4] = {
+                    src.texels[texelIndex(src, sx,          sy)],
+                    src.texels[texelIndex(src, sx + step_x, sy)],
+                    src.texels[texelIndex(src, sx,          sy + step_y)],
+                    src.texels[texelIndex(src, sx + step_x, sy + step_y)]
+                };
+                uint32_t r = 0, g = 0, b = 0;
+                for (int i = 0; i < 4; i++) {
+                    r += t[i] >> 11;
+                    g += (t[i] >> 5) & 0x3F;
+                    b += t[i] & 0x1F;
+                }
+                dst.texels[texelIndex(dst, x, y)] = (texel_t) (((r + 2) / 4) << 11 | ((g + 2) / 4) << 5 | (b + 2) / 4);
+            }
+        }
+    }
+}
+
+unsigned Model::selectMipLevel(int32_t uv_area2, int32_t screen_area2) const
+{
+    if (uv_area2     < 0) uv_area2     = -uv_area2;
+    if (screen_area2 < 0) screen_area2 = -screen_area2;
+    // Each level has a quarter of the texels of the previous one
+    unsigned level = 0;
+    while (level + 1 < mip_count && (uv_area2 >> (2 * (level + 1))) >= screen_area2)
+        level++;
+    return level;
+}
+
+const Fix16* Model::getFaceLight(const fix16_vec3& light_dir)
+{
+    if (face_light_valid
+        && face_light_rotation.x == rotation.x && face_light_rotation.y == rotation.y
+        && face_light_dir.x == light_dir.x && face_light_dir.y == light_dir.y && face_light_dir.z == light_dir.z
+    ){
+        return face_light;
+    }
+    // Light into model space instead of every normal into world space
+    const fix16_vec3 model_light_dir = rotateToModelSpace(rotation, light_dir);
+    for (unsigned f_id = 0; f_id < faces_count; ++f_id) {
+        face_light[f_id] = calculateLightIntensityDirLight(model_light_dir, face_normals[f_id], Fix16(1.0f));
+    }
+    face_light_rotation = rotation;
+    face_light_dir      = light_dir;
+    face_light_valid    = true;
+    return face_light;
+}
+
 // Changes the transfrom point of model by shifting all vertices
 void Model::_shiftTransform(fix16_vec3 transform)
 {
@@ -274,13 +344,14 @@ bool Model::load_from_binary_obj_file(char* fname, char* ftexture, bool center)
 
     // Center model
     //if(center)
+    (void) center;
     // Always center model to make things easier later on
     // TODO: If we want to avoid centering causing issues model to be at wrong location
     //       we can transform its position using the same amount as the vertices were tranformed...
         _centerModel();
 
     // Calculate encapsulating sphere size
-    //_calculateEncapsulatingSphere();
+    _calculateEncapsulatingSphere();
 
 
     // ~~~~~~~~~~~~~~~~~~~~~ Texture ~~~~~~~~~~~~~~~~~~~~~
@@ -331,12 +402,46 @@ bool Model::load_from_binary_obj_file(char* fname, char* ftexture, bool center)
 #else
     lseek(fd, lseek_texture_start, SEEK_SET);
 #endif
-    this->gen_uv_tex = (uint32_t*) malloc(sizeof(uint32_t) * tex_size_x*tex_size_y);
+    // File texels are 32b 0x00RRGGBB, converted row by row to RGB565 so the
+    // full size 32b texture is never in memory. Mip levels go in the same block.
+    uint32_t chain_size = 0;
+    uint32_t mip_w = tex_size_x, mip_h = tex_size_y;
+    for (mip_count = 0; mip_count < MIP_MAX_LEVELS; ) {
+        MipLevel& mip = mip_levels[mip_count++];
+        mip = {nullptr, (int) mip_w, (int) mip_h, 0, false};
+#ifdef TILED_TEXTURES
+        const bool pow2 = (mip_w & (mip_w - 1)) == 0 && (mip_h & (mip_h - 1)) == 0;
+        if (pow2 && mip_w >= 4 && mip_h >= 4) {
+            mip.tiled = true;
+            while ((1u << mip.width_log2) < mip_w)
+                mip.width_log2++;
+        }
+#endif
+        chain_size += mip_w * mip_h;
+        if (mip_w == 1 && mip_h == 1)
+            break;
+        if (mip_w > 1) mip_w /= 2;
+        if (mip_h > 1) mip_h /= 2;
+    }
+    this->gen_uv_tex = (texel_t*) malloc(sizeof(texel_t) * chain_size);
+    texel_t* mip_texels = this->gen_uv_tex;
+    for (unsigned level = 0; level < mip_count; level++) {
+        mip_levels[level].texels = mip_texels;
+        mip_texels += mip_levels[level].width * mip_levels[level].height;
+    }
+
+    uint32_t* row = (uint32_t*) malloc(sizeof(uint32_t) * tex_size_x);
+    for (uint32_t y = 0; y < tex_size_y; y++) {
 #ifndef PC
-    fread(this->gen_uv_tex, 1, tex_size_x*tex_size_y*4, fd);
+        fread(row, 1, tex_size_x*4, fd);
 #else
-    read(fd, this->gen_uv_tex, tex_size_x*tex_size_y*4);   // tex_size_x*tex_size_y(?x) * 32b Fix16 (4bytes)
+        read(fd, row, tex_size_x*4);
 #endif
+        for (uint32_t x = 0; x < tex_size_x; x++)
+            this->gen_uv_tex[texelIndex(mip_levels[0], x, y)] = rgb565(row[x] >> 16, row[x] >> 8, row[x]);
+    }
+    free(row);
+    _generateMipChain();
 
 #ifndef PC
     fclose(fd);
@@ -344,5 +449,10 @@ bool Model::load_from_binary_obj_file(char* fname, char* ftexture, bool center)
     close(fd);
 #endif
 
+    // Lighting needs face normals (only textured models can be lit)
+    this->face_normals = (fix16_vec3*) malloc(sizeof(fix16_vec3) * faces_count);
+    this->face_light   = (Fix16*)      malloc(sizeof(Fix16)      * faces_count);
+    _calculateFaceNormals();
+
     return true;
 }
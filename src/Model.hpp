@@ -10,6 +10,9 @@ struct u_pair {
     unsigned Second;
 };
 
+// Level 0 is the loaded texture, each next level halves it down to 1x1 or this many levels
+#define MIP_MAX_LEVELS 9
+
 struct u_triple {
     unsigned First;
     unsigned Second;
@@ -24,11 +27,6 @@ private:
     // Transform raw model vertices to the geometric center
     void _centerModel();
 
-#ifdef PER_MODEL_CLEAR
-    int16_t_vec2 bbox_max;
-    int16_t_vec2 bbox_min;
-#endif
-
 public:
 
     Model(char* fname, char* ftexture, bool centerVertices);
@@ -51,21 +49,29 @@ public:
     bool has_texture;
     int gen_textureWidth;
     int gen_textureHeight;
-    uint32_t * gen_uv_tex; // Malloced array of size: gen_textureWidth * gen_textureHeight
+    texel_t * gen_uv_tex; // Malloced array of size: gen_textureWidth * gen_textureHeight (RGB565)
+                          // followed by the smaller mip levels
+    MipLevel mip_levels[MIP_MAX_LEVELS]; // mip_levels[0].texels == gen_uv_tex
+    unsigned mip_count;
+
+    // Unit face normals in model space. Only textured models have them (lighting).
+    fix16_vec3* face_normals;
 
     fix16_vec3& getPosition_ref();
     fix16_vec2& getRotation_ref();
     fix16_vec3& getScale_ref();
-#ifdef PER_MODEL_CLEAR
-    int16_t_vec2& getBoundBox_max();
-    int16_t_vec2& getBoundBox_min();
-#endif
 
     uint16_t render_mode;
+    // Skip faces facing away from camera in textured modes.
+    // Turn off for open meshes whose inside can be seen.
+    bool cull_backfaces;
+    // Set by Renderer::update() when the bounding sphere is off screen
+    bool frustum_culled;
 
     color_t color;
 
     // size of a sphere that encapsulates the model (when model is centered using _centerModel)
+    // Also used for frustum culling: recalculate after changing the vertices.
     Fix16 encapsulating_radius;
     // Some extra info about collision (TODO: Perhaps there is better way. . .)
     unsigned char collision_extra;
@@ -86,4 +92,25 @@ public:
 
     void _update_vertex_center();
 
+    // Fills mip levels 1.. from level 0 (2x2 box filter)
+    void _generateMipChain();
+
+    // Mip level for a triangle covering uv_area2 level 0 texels and
+    // screen_area2 pixels (both twice the area, any sign): the smallest
+    // level that is sampled at most once per pixel along each axis.
+    unsigned selectMipLevel(int32_t uv_area2, int32_t screen_area2) const;
+
+    // (Re)calculates face_normals. Called at load and by the vertex scaling helpers.
+    void _calculateFaceNormals();
+
+    // Directional light intensity per face. Only recalculated when the
+    // model rotation or light_dir has changed since the last call.
+    const Fix16* getFaceLight(const fix16_vec3& light_dir);
+
+private:
+    Fix16*     face_light;
+    fix16_vec2 face_light_rotation;
+    fix16_vec3 face_light_dir;
+    bool       face_light_valid;
+
 };
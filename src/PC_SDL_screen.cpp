@@ -3,6 +3,10 @@
 
 #include "PC_SDL_screen.hpp"
 
+#include "RenderStats.hpp"
+
+#include "RenderUtils.hpp" // fillSpan
+
 #include <cstring>  // memset
 #include <iostream> // std::string
 
@@ -10,8 +14,10 @@ uint32_t screenPixels[SCREEN_X * SCREEN_Y];
 
 void setPixel        (int x, int y, uint32_t color)
 {
-    if(x>=0 && x < SCREEN_X && y>=0 && y < SCREEN_Y)
+    if(x>=0 && x < SCREEN_X && y>=0 && y < SCREEN_Y) {
         screenPixels[y * SCREEN_X + x] = color;
+        RENDER_STATS_ADD(pixels_written, 1);
+    }
 }
 
 void setPixel_Unsafe (int x, int y, uint32_t color)
@@ -31,11 +37,7 @@ uint32_t color(uint8_t R, uint8_t G, uint8_t B){
 
 void fillScreen(uint32_t color)
 {
-    for (int x=0; x<SCREEN_X; x++){
-        for (int y=0; y<SCREEN_Y; y++){
-            setPixel(x,y,color);
-        }
-    }
+    fillSpan(screenPixels, SCREEN_X * SCREEN_Y, color);
 }
 
 //Draw a line (bresanham line algorithm)
@@ -151,7 +153,7 @@ The triangle has three points P0, P1 and P2 and three lines a, b and c. We go fr
     line(x2,y2,x0,y0,colorLine);
 }
 
-int drawCharacter(char character, int x, int y, uint32_t* screenPixels) {
+int drawCharacter(char character, int x, int y, uint32_t* /*screenPixels*/) {
     const int SIZE_MULTIPLIER = 2; // Scale the text by integer
     const int BITMAP_SIZE     = 6; // bitmap x and y must be this size
     const char* bitmapNumbers6x6[] = {
@@ -0,0 +1,310 @@
+#ifdef PC
+// Include guard PC
+
+#include "Pipeline.hpp"
+
+#include "Profiler.hpp"
+
+#include <utility> // std::swap
+
+// ~~~~~~~~~~~~~~~~ Triple buffer ~~~~~~~~~~~~~~~~
+
+SnapshotBuffer::SnapshotBuffer()
+:   back_slot(0),
+    ready_slot(1),
+    front_slot(2),
+    fresh(false),
+    stopping(false)
+{
+}
+
+void SnapshotBuffer::publish(bool wait)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (wait)
+            changed.wait(lock, [this] { return !fresh || stopping; });
+        std::swap(back_slot, ready_slot);
+        fresh = true;
+    }
+    changed.notify_all();
+}
+
+const SceneSnapshot& SnapshotBuffer::acquire(bool wait)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (wait)
+            changed.wait(lock, [this] { return fresh || stopping; });
+        if (!fresh)
+            return slots[front_slot];
+        std::swap(front_slot, ready_slot);
+        fresh = false;
+    }
+    changed.notify_all();
+    return slots[front_slot];
+}
+
+void SnapshotBuffer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+}
+
+// ~~~~~~~~~~~~~~~~ Pipeline ~~~~~~~~~~~~~~~~
+
+ScenePipeline::ScenePipeline(
+    Renderer& renderer, Model* car_model, const Car& car,
+    Fix16 camera_car_distance, uint16_t camera_position_preset,
+    InputRecorder* recorder, bool lockstep
+)
+:   lockstep(lockstep),
+    input_first(0),
+    input_count(0),
+    stopping(false),
+    camera_car_distance(camera_car_distance),
+    camera_position_preset(camera_position_preset),
+    car_radius(car_model->encapsulating_radius),
+    models_sorted(false),
+    sort_camera_pos(renderer.get_camera_pos()),
+    recorder(recorder),
+    removed_applied(0),
+    applied_frames(0)
+{
+    scene.frames        = 0;
+    scene.input         = {};
+    scene.input.render_mode   = (uint8_t) car_model->render_mode;
+    scene.input.camera_preset = (uint8_t) camera_position_preset;
+    scene.car           = car;
+    scene.input.car_checksum  = scene.car.state_checksum();
+    scene.camera_pos    = renderer.get_camera_pos();
+    scene.camera_rot    = renderer.get_camera_rot();
+    scene.FOV           = renderer.get_FOV();
+    scene.minimap_pos   = renderer.get_minimapPos();
+    scene.car_position  = car_model->getPosition_ref();
+    scene.car_rotation  = car_model->getRotation_ref();
+    scene.removed_count = 0;
+#ifdef FRAME_PROFILER
+    scene.collision_ticks = 0;
+    scene.physics_ticks   = 0;
+#endif
+    z_buffer = renderer.get_zBuffer();
+
+    // Every map model in model list order, which is the order of the serial
+    // collision loop until the renderer first sorts the list
+    setup_ok = colliders.reserve(renderer.getModelCount())
+            && removed_models.reserve(renderer.getModelCount());
+    for (auto& it : renderer.getModelArray()) {
+        Model* m = it.first;
+        if (!setup_ok || m == car_model)
+            continue;
+        colliders.push_back({m, m->getPosition_ref(), m->encapsulating_radius, m->collision_extra, false});
+    }
+}
+
+ScenePipeline::~ScenePipeline()
+{
+    stop();
+}
+
+bool ScenePipeline::start()
+{
+    if (!setup_ok)
+        return false;
+    // The scene before the first frame is drawn while that one is simulated
+    snapshots.back() = scene;
+    snapshots.publish(false);
+    thread = std::thread(&ScenePipeline::threadLoop, this);
+    return true;
+}
+
+void ScenePipeline::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    input_ready.notify_all();
+    snapshots.stop();
+    if (thread.joinable())
+        thread.join();
+}
+
+void ScenePipeline::submit(const InputFrame& input)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (input_count < PIPELINE_INPUT_QUEUE) {
+            inputs[(input_first + input_count) % PIPELINE_INPUT_QUEUE] = input;
+            input_count++;
+        } else {
+            // Simulation fell behind: both inputs in one longer frame
+            InputFrame& last = inputs[(input_first + input_count - 1) % PIPELINE_INPUT_QUEUE];
+            last.dt            = fix16_add(last.dt, input.dt);
+            last.keys         |= input.keys;
+            last.render_mode   = input.render_mode;
+            last.camera_preset = input.camera_preset;
+        }
+    }
+    input_ready.notify_one();
+}
+
+const SceneSnapshot& ScenePipeline::acquire()
+{
+    return snapshots.acquire(lockstep);
+}
+
+void ScenePipeline::apply(const SceneSnapshot& scene, Renderer& renderer, Model* car_model)
+{
+    renderer.get_camera_pos()  = scene.camera_pos;
+    renderer.get_camera_rot()  = scene.camera_rot;
+    renderer.get_FOV()         = scene.FOV;
+    renderer.get_minimapPos()  = scene.minimap_pos;
+    // The scene before the first frame leaves the model list unsorted: the
+    // serial loop sorts it first for frame 0 and ties keep the list order
+    renderer.camera_move_dirty = (scene.frames > 0);
+
+    car_model->getPosition_ref() = scene.car_position;
+    car_model->getRotation_ref() = scene.car_rotation;
+    car_model->render_mode       = scene.input.render_mode;
+
+    // Boosts picked up in this snapshot or in ones that were never acquired
+    Model** removed = removed_models.getRawArray();
+    for (; removed_applied < scene.removed_count; removed_applied++) {
+        for (auto iter = renderer.getModelArray().node_begin(); iter != renderer.getModelArray().node_end(); ++iter) {
+            auto node = (*iter);
+            if (node->data.first != removed[removed_applied])
+                continue;
+            // Free memory of the created model
+            delete node->data.first;
+            renderer.getModelArray().remove(*node);
+            break;
+        }
+    }
+
+#ifdef FRAME_PROFILER
+    // A snapshot acquired again is not simulated again
+    if (scene.frames != applied_frames) {
+        profiler_add(PROF_COLLISION, scene.collision_ticks);
+        profiler_add(PROF_PHYSICS,   scene.physics_ticks);
+    }
+#endif
+    applied_frames = scene.frames;
+}
+
+// ~~~~~~~~~~~~~~~~ Simulation thread ~~~~~~~~~~~~~~~~
+
+void ScenePipeline::threadLoop()
+{
+    for (;;) {
+        InputFrame input;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            input_ready.wait(lock, [this] { return input_count > 0 || stopping; });
+            // Inputs left at stop() are still simulated (and recorded)
+            if (input_count == 0)
+                return;
+            input = inputs[input_first];
+            input_first = (input_first + 1) % PIPELINE_INPUT_QUEUE;
+            input_count--;
+        }
+        simulate(input);
+        snapshots.back() = scene;
+        snapshots.publish(lockstep);
+    }
+}
+
+void ScenePipeline::collide()
+{
+    // The serial loop walks the renderer's model list and takes the first
+    // model the car touches. Once sorted the list runs from the farthest
+    // model to the nearest as seen from the camera of the last frame, so of
+    // all touched models that is the farthest one (equal distances: the one
+    // added first).
+    Collider* hit = nullptr;
+    Fix16 hit_distance = 0.0f;
+    for (unsigned i = 0; i < colliders.getSize(); i++) {
+        Collider& c = colliders[i];
+        if (c.removed)
+            continue;
+        const auto combinedPos = sub_vec3(scene.car_position, c.position);
+        Fix16 dist = calculateLength(combinedPos);
+        if (dist > (c.radius + car_radius)/2.0f)
+            continue;
+        if (!models_sorted) {
+            hit = &c;
+            break;
+        }
+        const Fix16 camera_distance = calculateDistance(c.position, sort_camera_pos);
+        if (!hit || camera_distance > hit_distance) {
+            hit = &c;
+            hit_distance = camera_distance;
+        }
+    }
+    if (!hit)
+        return;
+
+    if (hit->collision_extra == 2){
+        scene.car.add_boost(MAX_BOOST_TIME/4.0f);
+        // --- Remove boost ----
+        // Deleted by the main thread once it applies the snapshot
+        hit->removed = true;
+        removed_models.push_back(hit->model);
+        scene.removed_count++;
+    }
+    else if (hit->collision_extra == 1){
+        // Wall
+        scene.car.get_speed() = -15.0f;
+    }
+}
+
+void ScenePipeline::simulate(const InputFrame& input)
+{
+    scene.frames++;
+    scene.input = input;
+
+    if (input.camera_preset != camera_position_preset) {
+        camera_position_preset = input.camera_preset;
+        apply_camera_preset(camera_position_preset, scene.camera_pos, scene.camera_rot, scene.FOV, camera_car_distance);
+    }
+
+#ifdef FRAME_PROFILER
+    const uint32_t t0 = profiler_ticks();
+#endif
+    collide();
+#ifdef FRAME_PROFILER
+    const uint32_t t1 = profiler_ticks();
+#endif
+    update_car_frame(scene.car, Fix16(input.dt),
+        input.keys & INPUT_ACCELERATE, input.keys & INPUT_BRAKE,
+        input.keys & INPUT_TURN_LEFT,  input.keys & INPUT_TURN_RIGHT,
+        input.keys & INPUT_BOOST,
+        camera_car_distance, scene.camera_pos, scene.camera_rot, scene.car_rotation.x
+    );
+#ifdef FRAME_PROFILER
+    const uint32_t t2 = profiler_ticks();
+    scene.collision_ticks = t1 - t0;
+    scene.physics_ticks   = t2 - t1;
+#endif
+    scene.input.car_checksum = scene.car.state_checksum();
+    if (recorder)
+        recorder->write(scene.input);
+
+    // Same as the serial loop after its physics
+    scene.car_position.x = scene.car.get_pos().x;
+    scene.car_position.z = scene.car.get_pos().y;
+    scene.FOV = Fix16(170.0f) - scene.car.get_speed_perc()*30.0f;
+    scene.minimap_pos.x = -scene.car.get_pos().x;
+    scene.minimap_pos.y = -scene.car.get_pos().y;
+
+    // The renderer sorts its models when it draws this frame (not with a
+    // depth buffer), the next collide() sees them in that order
+    models_sorted   = !z_buffer;
+    sort_camera_pos = scene.camera_pos;
+}
+
+// Include guard PC
+#endif // PC
@@ -0,0 +1,170 @@
+#pragma once
+
+// Pipelined simulation and rendering (host build only).
+//
+// ScenePipeline runs the collisions and car physics of the main loop on a
+// thread of its own. Every simulated frame ends in an immutable SceneSnapshot
+// (car, camera, car model transform, picked up boosts) published to a triple
+// buffer. The main thread submits the input of a frame, takes the newest
+// snapshot, applies it to the Renderer and draws it while the simulation
+// thread is busy with the next frame. The screen is one simulated frame
+// behind the input.
+//
+// Snapshot of frame k holds what the serial main loop has at frame k: same
+// collisions, same physics and the same Renderer state once applied. A
+// lockstep pipeline (headless) draws every snapshot in order, so its per-frame
+// checksums match a serial run. Without lockstep (SDL) the simulation never
+// waits for the renderer and the renderer takes whichever frame is newest.
+//
+// Map models never move, the car model is the only transform to carry.
+// Keys outside InputFrame (free camera distance and height) do nothing while
+// pipelined, same as in replays.
+
+#ifdef PC
+
+#include "Car.hpp"
+
+#include "DynamicArray.hpp"
+
+#include "InputRecord.hpp"
+
+#include "Renderer.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+
+// Inputs submitted but not simulated yet. A full queue merges the newest
+// input into the last one.
+#define PIPELINE_INPUT_QUEUE 4
+
+struct SceneSnapshot
+{
+    uint32_t   frames;     // Frames simulated, 0 for the scene before the first one
+    InputFrame input;      // Input of the last frame, car_checksum filled in
+    Car        car;
+    fix16_vec3 camera_pos;
+    fix16_vec2 camera_rot;
+    Fix16      FOV;
+    int16_t_vec2 minimap_pos;
+    fix16_vec3 car_position;
+    fix16_vec2 car_rotation;
+    // Boosts picked up so far: the first removed_count of ScenePipeline's log
+    uint32_t   removed_count;
+#ifdef FRAME_PROFILER
+    // Measured on the simulation thread, profiler_add()ed when applied
+    uint32_t   collision_ticks;
+    uint32_t   physics_ticks;
+#endif
+};
+
+// Triple buffer: the writer fills back() while the reader holds the front
+// slot, publish() and acquire() swap them with the ready one in between.
+class SnapshotBuffer {
+private:
+    SceneSnapshot slots[3];
+    unsigned back_slot;
+    unsigned ready_slot;
+    unsigned front_slot;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    // Guarded by mutex
+    bool fresh;     // Ready slot holds a snapshot not acquired yet
+    bool stopping;
+
+public:
+    SnapshotBuffer();
+
+    // Slot the writer fills next
+    SceneSnapshot& back() { return slots[back_slot]; }
+    // Makes back() the newest snapshot. wait: first wait until the previous
+    // one was acquired instead of replacing it.
+    void publish(bool wait);
+
+    // Newest published snapshot, valid until the next acquire(). wait: wait
+    // for one not acquired yet instead of returning the last one again.
+    const SceneSnapshot& acquire(bool wait);
+
+    // Ends all waiting, for good
+    void stop();
+};
+
+class ScenePipeline {
+private:
+    // Map model as seen by the collision check
+    struct Collider {
+        Model*       model;
+        fix16_vec3   position;
+        Fix16        radius;
+        uint8_t      collision_extra;
+        bool         removed;
+    };
+
+    SnapshotBuffer snapshots;
+    bool lockstep;
+    std::thread thread;
+
+    std::mutex mutex;
+    std::condition_variable input_ready;
+    // Guarded by mutex
+    InputFrame inputs[PIPELINE_INPUT_QUEUE];
+    unsigned   input_first;
+    unsigned   input_count;
+    bool       stopping;
+
+    // ~~~~ Simulation thread only ~~~~
+    SceneSnapshot scene;          // State after the last simulated frame
+    Fix16         camera_car_distance;
+    uint16_t      camera_position_preset;
+    Fix16         car_radius;
+    DynamicArray<Collider> colliders;
+    bool          z_buffer;
+    bool          models_sorted;  // Renderer sorted its models by camera distance
+    fix16_vec3    sort_camera_pos;
+    InputRecorder* recorder;
+
+    // Written by the simulation thread before the snapshot holding them is
+    // published, never reallocated
+    DynamicArray<Model*> removed_models;
+
+    // ~~~~ Main thread only ~~~~
+    uint32_t removed_applied;
+    uint32_t applied_frames;
+
+    bool setup_ok;
+
+    void threadLoop();
+    void simulate(const InputFrame& input);
+    void collide();
+
+public:
+    // Starts from the scene, model list and car model of renderer and from
+    // car. recorder (if open) gets every simulated input.
+    ScenePipeline(
+        Renderer& renderer, Model* car_model, const Car& car,
+        Fix16 camera_car_distance, uint16_t camera_position_preset,
+        InputRecorder* recorder, bool lockstep
+    );
+    ~ScenePipeline();
+
+    // Starts the simulation thread. Returns false without memory for the
+    // collision state, nothing is simulated then.
+    bool start();
+    // Simulates remaining inputs and ends the simulation thread
+    void stop();
+
+    // Input of the next frame
+    void submit(const InputFrame& input);
+
+    // Newest snapshot (lockstep: the next one in order), valid until the
+    // next acquire()
+    const SceneSnapshot& acquire();
+
+    // Moves renderer camera and car model to scene and removes the boosts
+    // picked up since the last apply()
+    void apply(const SceneSnapshot& scene, Renderer& renderer, Model* car_model);
+};
+
+#endif // PC
@@ -0,0 +1,139 @@
+#ifdef FRAME_PROFILER
+// Include guard FRAME_PROFILER
+
+#include "Profiler.hpp"
+
+#include "Renderer.hpp"
+
+#include "RenderUtils.hpp"
+
+#include "DirtyRects.hpp"
+
+#ifndef PC
+#   include <sdk/calc/calc.h>
+#   include <sdk/os/debug.h>
+    extern uint8_t *R64CNT; // fps_functions.cpp
+#else
+#   include "PC_SDL_screen.hpp" // replaces "sdk/os/lcd.hpp"
+#   include <chrono>
+#endif
+
+// Overlay placement (below the FPS counter)
+#define PROFILER_OVERLAY_X     2
+#define PROFILER_OVERLAY_Y     36
+#define PROFILER_OVERLAY_W     200
+#define PROFILER_BAR_MAX_W     100
+#define PROFILER_BAR_H         4
+#ifdef PC
+#   define PROFILER_ROW_H      14 // sdl_debug_uint32_t digits are 12px high
+#else
+#   define PROFILER_ROW_H      12 // Debug_Printf character height
+#endif
+
+static uint32_t zone_current[PROF_ZONE_COUNT];
+static uint32_t zone_history[PROFILER_HISTORY][PROF_ZONE_COUNT];
+static unsigned history_head   = 0;
+static unsigned history_filled = 0;
+
+uint32_t profiler_ticks()
+{
+#ifdef PC
+    return (uint32_t) std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+#else
+    return *R64CNT;
+#endif
+}
+
+void profiler_add(uint8_t zone, uint32_t ticks)
+{
+#ifndef PC
+    // R64CNT is 7 bits wide
+    ticks &= 0b01111111;
+#endif
+    zone_current[zone] += ticks;
+}
+
+void profiler_frame_end()
+{
+    for (unsigned z = 0; z < PROF_ZONE_COUNT; z++) {
+        zone_history[history_head][z] = zone_current[z];
+        zone_current[z] = 0;
+    }
+    history_head = (history_head + 1) % PROFILER_HISTORY;
+    if (history_filled < PROFILER_HISTORY)
+        history_filled++;
+}
+
+static uint32_t ticks_to_us(uint32_t ticks)
+{
+#ifdef PC
+    return ticks;
+#else
+    // 1 tick = 1/128 s = 7812.5 us
+    return ticks * 15625u / 2u;
+#endif
+}
+
+uint32_t profiler_average_us(uint8_t zone)
+{
+    if (history_filled == 0)
+        return 0;
+    uint32_t sum = 0;
+    for (unsigned i = 0; i < history_filled; i++)
+        sum += zone_history[i][zone];
+    return ticks_to_us(sum) / history_filled;
+}
+
+uint32_t profiler_last_frame_us(uint8_t zone)
+{
+    const unsigned last = (history_head + PROFILER_HISTORY - 1) % PROFILER_HISTORY;
+    return ticks_to_us(zone_history[last][zone]);
+}
+
+const char* profiler_zone_name(uint8_t zone)
+{
+    static const char* names[PROF_ZONE_COUNT] = {
+        "collision", "physics", "model-sort", "transform", "sort", "draw", "ui", "present", "clear"
+    };
+    return names[zone];
+}
+
+void profiler_draw_overlay()
+{
+    static const uint8_t bar_colors[PROF_ZONE_COUNT][3] = {
+        {200,  40,  40}, {200, 120,  40}, {200, 200,  40}, { 40, 160,  40}, { 40, 160, 160},
+        { 40,  40, 200}, {160,  40, 160}, { 90,  90,  90}, {  0,   0,   0}
+    };
+
+    uint32_t avg[PROF_ZONE_COUNT];
+    uint32_t total = 0;
+    for (uint8_t z = 0; z < PROF_ZONE_COUNT; z++) {
+        avg[z] = profiler_average_us(z);
+        total += avg[z];
+    }
+    if (total == 0)
+        total = 1;
+
+    dirty_rects.add(0, PROFILER_OVERLAY_Y, PROFILER_OVERLAY_W, PROFILER_OVERLAY_Y + PROF_ZONE_COUNT * PROFILER_ROW_H);
+
+    for (uint8_t z = 0; z < PROF_ZONE_COUNT; z++) {
+        // Bar length is the share of the profiled frame time
+        const int y = PROFILER_OVERLAY_Y + z * PROFILER_ROW_H;
+        const int w = (int) ((uint64_t) avg[z] * PROFILER_BAR_MAX_W / total);
+        const color_t c = color(bar_colors[z][0], bar_colors[z][1], bar_colors[z][2]);
+        fillRect(PROFILER_OVERLAY_X, y, PROFILER_OVERLAY_X + w + 1, y + PROFILER_BAR_H, c);
+#ifdef PC
+        sdl_debug_uint32_t(avg[z], PROFILER_OVERLAY_X + PROFILER_BAR_MAX_W + 6, y);
+#else
+        Debug_Printf(
+            (PROFILER_OVERLAY_X + PROFILER_BAR_MAX_W) / 6 + 1, y / PROFILER_ROW_H,
+            false, 0, "%-9s%6d", profiler_zone_name(z), (int) avg[z]
+        );
+#endif
+    }
+}
+
+// Include guard FRAME_PROFILER
+#endif // FRAME_PROFILER
@@ -0,0 +1,72 @@
+#pragma once
+
+// Per-stage frame profiler.
+//
+// Wrap a stage in a scope with PROFILE_ZONE(zone). Time spent in each zone is
+// summed per frame and profiler_frame_end() pushes the sums into a ring
+// buffer of the last PROFILER_HISTORY frames. Averages over the ring buffer
+// are drawn as bars by profiler_draw_overlay().
+//
+// Only enabled when FRAME_PROFILER is defined, otherwise everything here
+// compiles to nothing.
+//
+// Time source: PC uses the steady clock (microseconds). The calculator only
+// has the 128Hz R64CNT counter, so single frames mostly read 0 or 1 tick but
+// the average over the ring buffer still converges to the real stage cost.
+
+#include <stdint.h>
+
+enum PROFILER_ZONES {
+    PROF_COLLISION = 0,
+    PROF_PHYSICS,
+    PROF_MODEL_SORT, // Model distances + DynamicLinkedList::sort
+    PROF_TRANSFORM, // Vertex projection
+    PROF_SORT,      // Face depth + sorting (and normals)
+    PROF_DRAW,      // Rasterization
+    PROF_UI,        // Rotation visualizer, minimap, car UI
+    PROF_PRESENT,   // LCD_Refresh / SDL texture upload
+    PROF_CLEAR,     // Bounding box clears
+    PROF_ZONE_COUNT
+};
+
+#ifdef FRAME_PROFILER
+
+#define PROFILER_HISTORY 32
+
+// Raw timer ticks (PC: microseconds, calculator: 1/128 s)
+uint32_t profiler_ticks();
+
+void profiler_add(uint8_t zone, uint32_t ticks);
+
+class ProfileZone
+{
+private:
+    uint32_t t0;
+    uint8_t  zone;
+public:
+    ProfileZone(uint8_t zone) : t0(profiler_ticks()), zone(zone) {}
+    ~ProfileZone() { profiler_add(zone, profiler_ticks() - t0); }
+};
+
+#   define _PROFILE_ZONE_NAME2(line) _profile_zone_##line
+#   define _PROFILE_ZONE_NAME(line)  _PROFILE_ZONE_NAME2(line)
+#   define PROFILE_ZONE(zone)        ProfileZone _PROFILE_ZONE_NAME(__LINE__)(zone)
+
+// Moves current frame zone times into the ring buffer
+void profiler_frame_end();
+
+// Average time of zone over the ring buffer in microseconds
+uint32_t profiler_average_us(uint8_t zone);
+// Time of zone in the most recently finished frame in microseconds
+uint32_t profiler_last_frame_us(uint8_t zone);
+
+const char* profiler_zone_name(uint8_t zone);
+
+// Draws the bar overlay (top left corner), cleared with the other dirty rects
+void profiler_draw_overlay();
+
+#else
+
+#   define PROFILE_ZONE(zone) ((void) 0)
+
+#endif // FRAME_PROFILER
@@ -85,3 +85,288 @@ fix16_vec2 getScreenCoordinate(
 
     return fix16_vec2({sx, sy});
 }
+
+// Matrix of rotateOnPlane(x, z, rotation.x) followed by rotateOnPlane(y, z, rotation.y)
+static void getRotationMatrix(fix16_vec2 rotation, Fix16 out[3][3])
+{
+    const Fix16 sin_x = rotation.x.sin();
+    const Fix16 cos_x = rotation.x.cos();
+    const Fix16 sin_y = rotation.y.sin();
+    const Fix16 cos_y = rotation.y.cos();
+
+    out[0][0] = cos_x;         out[0][1] = 0.0f;  out[0][2] = -sin_x;
+    out[1][0] = -sin_y*sin_x;  out[1][1] = cos_y; out[1][2] = -sin_y*cos_x;
+    out[2][0] = cos_y*sin_x;   out[2][1] = sin_y; out[2][2] = cos_y*cos_x;
+}
+
+fix16_mat3x4 getCameraMatrix(fix16_vec3 camera_pos, fix16_vec2 camera_rot)
+{
+    fix16_mat3x4 out;
+    getRotationMatrix(camera_rot, out.m);
+    // t = -rotation * camera_pos
+    const auto& m = out.m;
+    out.t.x = -(m[0][0]*camera_pos.x + m[0][1]*camera_pos.y + m[0][2]*camera_pos.z);
+    out.t.y = -(m[1][0]*camera_pos.x + m[1][1]*camera_pos.y + m[1][2]*camera_pos.z);
+    out.t.z = -(m[2][0]*camera_pos.x + m[2][1]*camera_pos.y + m[2][2]*camera_pos.z);
+    return out;
+}
+
+fix16_mat3x4 getModelViewMatrix(
+    const fix16_mat3x4& camera,
+    fix16_vec3 translate, fix16_vec2 rotation, fix16_vec3 scale
+) {
+    Fix16 model[3][3];
+    getRotationMatrix(rotation, model);
+    const auto& c = camera.m;
+
+    fix16_mat3x4 out;
+    // m = camera * model * diag(scale)
+    const Fix16 scales[3] = {scale.x, scale.y, scale.z};
+    for (int r = 0; r < 3; r++) {
+        for (int col = 0; col < 3; col++) {
+            Fix16 sum = c[r][0]*model[0][col] + c[r][1]*model[1][col] + c[r][2]*model[2][col];
+            out.m[r][col] = sum * scales[col];
+        }
+    }
+    // t = camera * translate + camera.t
+    out.t.x = c[0][0]*translate.x + c[0][1]*translate.y + c[0][2]*translate.z + camera.t.x;
+    out.t.y = c[1][0]*translate.x + c[1][1]*translate.y + c[1][2]*translate.z + camera.t.y;
+    out.t.z = c[2][0]*translate.x + c[2][1]*translate.y + c[2][2]*translate.z + camera.t.z;
+    return out;
+}
+
+fix16_vec3 rotateToModelSpace(fix16_vec2 rotation, fix16_vec3 dir)
+{
+    Fix16 m[3][3];
+    getRotationMatrix(rotation, m);
+    // Rotation matrix is orthonormal, inverse = transpose
+    return {
+        m[0][0]*dir.x + m[1][0]*dir.y + m[2][0]*dir.z,
+        m[0][1]*dir.x + m[1][1]*dir.y + m[2][1]*dir.z,
+        m[0][2]*dir.x + m[1][2]*dir.y + m[2][2]*dir.z,
+    };
+}
+
+void projectVertices(
+    const fix16_mat3x4& model_view, Fix16 FOV,
+    const fix16_vec3* vertices, unsigned vertex_count,
+    int16_t_vec2* screen_coords, Fix16* z_depths,
+    uint16_t* inv_depths,
+    uint8_t* outcodes
+) {
+    const auto& m = model_view.m;
+    const Fix16 near = NEAR_DISTANCE;
+    const Fix16 screen_x = (int16_t) SCREEN_X;
+    const Fix16 screen_y = (int16_t) SCREEN_Y;
+    const Fix16 guard_min   = (int16_t) -GUARD_BAND;
+    const Fix16 guard_max_x = (int16_t) (SCREEN_X + GUARD_BAND);
+    const Fix16 guard_max_y = (int16_t) (SCREEN_Y + GUARD_BAND);
+    // FOV/z is at hand already: NEAR/z = FOV/z * NEAR/FOV
+    const Fix16 inv_depth_scale = Fix16(Z_BUFFER_NEAR) / FOV;
+    for (unsigned v_id=0; v_id<vertex_count; v_id++) {
+        const fix16_vec3& p = vertices[v_id];
+        const Fix16 x = m[0][0]*p.x + m[0][1]*p.y + m[0][2]*p.z + model_view.t.x;
+        const Fix16 y = m[1][0]*p.x + m[1][1]*p.y + m[1][2]*p.z + model_view.t.y;
+        Fix16       z = m[2][0]*p.x + m[2][1]*p.y + m[2][2]*p.z + model_view.t.z;
+
+        if (z_depths)
+            z_depths[v_id] = z;
+
+        // Rest is the same as getScreenCoordinate
+        if (z == 0.0f){
+            z = 0.001f;
+        }
+        auto focal = FOV/z;
+        auto realx = x*focal;
+        auto realy = y*focal;
+#ifdef LANDSCAPE_MODE
+        Fix16 sx = Fix16((int16_t) (SCREEN_X/2)) - (realy);
+        Fix16 sy = Fix16((int16_t) (SCREEN_Y/2)) + (realx);
+#else
+        Fix16 sx = Fix16((int16_t) (SCREEN_X/2)) + (realx);
+        Fix16 sy = Fix16((int16_t) (SCREEN_Y/2)) + (realy);
+#endif
+        uint8_t code;
+        if (z < near) {
+            code = OUTCODE_NEAR;
+        } else {
+            code = 0;
+            if      (sx < 0.0f)     code |= OUTCODE_LEFT;
+            else if (sx > screen_x) code |= OUTCODE_RIGHT;
+            if      (sy < 0.0f)     code |= OUTCODE_TOP;
+            else if (sy > screen_y) code |= OUTCODE_BOTTOM;
+            if (code && (sx < guard_min || sx > guard_max_x || sy < guard_min || sy > guard_max_y))
+                code |= OUTCODE_GUARD;
+        }
+        if (code & OUTCODE_CLIP) {
+            sx = (int16_t) -999;
+        }
+        screen_coords[v_id] = {(int16_t) sx, (int16_t) sy};
+        if (outcodes)
+            outcodes[v_id] = code;
+
+        if (inv_depths) {
+            const fix16_t inv_depth = (focal * inv_depth_scale).value;
+            if (sx == (int16_t) -999)   inv_depths[v_id] = 0;
+            else if (inv_depth > 65535) inv_depths[v_id] = 65535;
+            else                        inv_depths[v_id] = (uint16_t) inv_depth;
+        }
+    }
+}
+
+int16_t_vec2 projectPoint(Fix16 FOV, const fix16_vec3& p, uint16_t* inv_depth)
+{
+    const Fix16 focal = FOV/p.z;
+#ifdef LANDSCAPE_MODE
+    const Fix16 sx = Fix16((int16_t) (SCREEN_X/2)) - p.y*focal;
+    const Fix16 sy = Fix16((int16_t) (SCREEN_Y/2)) + p.x*focal;
+#else
+    const Fix16 sx = Fix16((int16_t) (SCREEN_X/2)) + p.x*focal;
+    const Fix16 sy = Fix16((int16_t) (SCREEN_Y/2)) + p.y*focal;
+#endif
+    if (inv_depth) {
+        const fix16_t value = (focal * (Fix16(Z_BUFFER_NEAR) / FOV)).value;
+        *inv_depth = value > 65535 ? 65535 : (uint16_t) value;
+    }
+    return {(int16_t) sx, (int16_t) sy};
+}
+
+fix16_clip_volume getClipVolume(Fix16 FOV)
+{
+    // Same mapping as the projection: camera x is screen y in landscape
+#ifdef LANDSCAPE_MODE
+    const Fix16 half_x = (int16_t) (SCREEN_Y/2 + GUARD_BAND);
+    const Fix16 half_y = (int16_t) (SCREEN_X/2 + GUARD_BAND);
+#else
+    const Fix16 half_x = (int16_t) (SCREEN_X/2 + GUARD_BAND);
+    const Fix16 half_y = (int16_t) (SCREEN_Y/2 + GUARD_BAND);
+#endif
+    fix16_clip_volume out;
+    out.near = NEAR_DISTANCE;
+    out.guard_slope_x = half_x / FOV;
+    out.guard_slope_y = half_y / FOV;
+    return out;
+}
+
+#define CLIP_PLANE_COUNT 5
+
+// Signed distance-like value to clip plane, inside if >= 0
+static inline Fix16 clip_distance(const fix16_clip_volume& clip, unsigned plane, const fix16_vec3& p)
+{
+    switch (plane) {
+        case 0:  return p.z - clip.near;
+        case 1:  return p.z*clip.guard_slope_x - p.x;
+        case 2:  return p.z*clip.guard_slope_x + p.x;
+        case 3:  return p.z*clip.guard_slope_y - p.y;
+        default: return p.z*clip.guard_slope_y + p.y;
+    }
+}
+
+static inline clip_vertex clip_lerp(const clip_vertex& a, const clip_vertex& b, Fix16 t)
+{
+    return {
+        {
+            a.pos.x + (b.pos.x - a.pos.x)*t,
+            a.pos.y + (b.pos.y - a.pos.y)*t,
+            a.pos.z + (b.pos.z - a.pos.z)*t,
+        },
+        a.u + (b.u - a.u)*t,
+        a.v + (b.v - a.v)*t,
+    };
+}
+
+unsigned clipPolygon(const fix16_clip_volume& clip, clip_vertex* poly, unsigned count, clip_vertex* scratch)
+{
+    clip_vertex* in  = poly;
+    clip_vertex* out = scratch;
+    for (unsigned plane = 0; plane < CLIP_PLANE_COUNT && count > 0; plane++) {
+        // Sutherland-Hodgman: keep inside vertices, add crossings of each edge
+        unsigned out_count = 0;
+        const clip_vertex* prev = &in[count - 1];
+        Fix16 prev_d = clip_distance(clip, plane, prev->pos);
+        for (unsigned i = 0; i < count; i++) {
+            const clip_vertex* cur = &in[i];
+            const Fix16 cur_d = clip_distance(clip, plane, cur->pos);
+            if ((prev_d >= 0.0f) != (cur_d >= 0.0f) && out_count < CLIP_MAX_VERTICES)
+                out[out_count++] = clip_lerp(*prev, *cur, prev_d / (prev_d - cur_d));
+            if (cur_d >= 0.0f && out_count < CLIP_MAX_VERTICES)
+                out[out_count++] = *cur;
+            prev   = cur;
+            prev_d = cur_d;
+        }
+        count = out_count;
+        clip_vertex* tmp = in;
+        in  = out;
+        out = tmp;
+    }
+    if (in != poly) {
+        for (unsigned i = 0; i < count; i++)
+            poly[i] = in[i];
+    }
+    return count;
+}
+
+bool clipSegment(const fix16_clip_volume& clip, fix16_vec3& a, fix16_vec3& b)
+{
+    for (unsigned plane = 0; plane < CLIP_PLANE_COUNT; plane++) {
+        const Fix16 da = clip_distance(clip, plane, a);
+        const Fix16 db = clip_distance(clip, plane, b);
+        if (da < 0.0f && db < 0.0f)
+            return false;
+        if (da >= 0.0f && db >= 0.0f)
+            continue;
+        const Fix16 t = da / (da - db);
+        const fix16_vec3 crossing = {a.x + (b.x - a.x)*t, a.y + (b.y - a.y)*t, a.z + (b.z - a.z)*t};
+        if (da < 0.0f) a = crossing;
+        else           b = crossing;
+    }
+    return true;
+}
+
+fix16_frustum getViewFrustum(Fix16 FOV, Fix16 far_distance)
+{
+    // Camera x/y is visible while |x*FOV/z| <= half of the screen on that axis.
+    // Margin covers the rounding of projected coordinates.
+    const int16_t margin = 2;
+#ifdef LANDSCAPE_MODE
+    const Fix16 half_x = (int16_t) (SCREEN_Y/2 + margin);
+    const Fix16 half_y = (int16_t) (SCREEN_X/2 + margin);
+#else
+    const Fix16 half_x = (int16_t) (SCREEN_X/2 + margin);
+    const Fix16 half_y = (int16_t) (SCREEN_Y/2 + margin);
+#endif
+    // Edge plane x = z*half/FOV, normal (1, -half/FOV) normalized.
+    // (FOV, -half) would overflow in the length calculation.
+    const auto edge_normal = [FOV](Fix16 half) {
+        fix16_vec3 n = {1.0f, 0.0f, -(half/FOV)};
+        normalize_fix16_vec3(n);
+        return fix16_vec2({n.x, n.z});
+    };
+
+    fix16_frustum out;
+    out.plane_x = edge_normal(half_x);
+    out.plane_y = edge_normal(half_y);
+    out.far_distance = far_distance;
+    return out;
+}
+
+bool isSphereVisible(
+    const fix16_frustum& frustum, const fix16_mat3x4& camera,
+    fix16_vec3 center, Fix16 radius
+) {
+    const auto& m = camera.m;
+    const Fix16 z = m[2][0]*center.x + m[2][1]*center.y + m[2][2]*center.z + camera.t.z;
+    // Behind camera or too far
+    if (z < -radius || z - radius > frustum.far_distance)
+        return false;
+
+    // Left/right and top/bottom are symmetric
+    const Fix16 x = m[0][0]*center.x + m[0][1]*center.y + m[0][2]*center.z + camera.t.x;
+    if (Fix16(fix16_abs(x))*frustum.plane_x.x + z*frustum.plane_x.y > radius)
+        return false;
+    const Fix16 y = m[1][0]*center.x + m[1][1]*center.y + m[1][2]*center.z + camera.t.y;
+    if (Fix16(fix16_abs(y))*frustum.plane_y.x + z*frustum.plane_y.y > radius)
+        return false;
+
+    return true;
+}
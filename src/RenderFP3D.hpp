@@ -13,3 +13,120 @@ fix16_vec2 getScreenCoordinate(
     Fix16* z_depth,
     bool* is_valid
 );
+
+// Model space -> camera space transform: view = m * point + t
+struct fix16_mat3x4
+{
+    Fix16      m[3][3];
+    fix16_vec3 t;
+};
+
+// World space -> camera space. Once per frame.
+fix16_mat3x4 getCameraMatrix(fix16_vec3 camera_pos, fix16_vec2 camera_rot);
+
+// Same transform as getScreenCoordinate (scale, model rotation, translation,
+// camera rotation) combined into one matrix. Computed once per model per
+// frame, this replaces the 8 sin/cos evaluations per vertex with 9 multiply-adds.
+fix16_mat3x4 getModelViewMatrix(
+    const fix16_mat3x4& camera,
+    fix16_vec3 translate, fix16_vec2 rotation, fix16_vec3 scale
+);
+
+// Inverse of the model rotation of getScreenCoordinate: world space direction -> model space
+fix16_vec3 rotateToModelSpace(fix16_vec2 rotation, fix16_vec3 dir);
+
+// Outcodes of projectVertices. Sides are relative to the screen rectangle.
+#define OUTCODE_LEFT   0x01
+#define OUTCODE_RIGHT  0x02
+#define OUTCODE_TOP    0x04
+#define OUTCODE_BOTTOM 0x08
+#define OUTCODE_NEAR   0x10 // Closer than NEAR_DISTANCE (no side bits)
+#define OUTCODE_GUARD  0x20 // Beyond GUARD_BAND
+// Vertex got x = -999, faces and lines using it need clipping
+#define OUTCODE_CLIP   (OUTCODE_NEAR | OUTCODE_GUARD)
+
+// All vertices outside the same screen side or the near plane
+inline bool outcodesRejected(uint8_t a, uint8_t b, uint8_t c)
+{
+    return (a & b & c & (OUTCODE_LEFT | OUTCODE_RIGHT | OUTCODE_TOP | OUTCODE_BOTTOM | OUTCODE_NEAR)) != 0;
+}
+
+// Batch version of getScreenCoordinate. Vertices closer than NEAR_DISTANCE
+// or beyond GUARD_BAND get x = -999.
+// z_depths may be nullptr if not needed. inv_depths gets the depth buffer
+// value of each vertex (Z_BUFFER_NEAR/z in 16 bits, 0 if invalid).
+// outcodes gets the OUTCODE_ bits of each vertex.
+void projectVertices(
+    const fix16_mat3x4& model_view, Fix16 FOV,
+    const fix16_vec3* vertices, unsigned vertex_count,
+    int16_t_vec2* screen_coords, Fix16* z_depths,
+    uint16_t* inv_depths = nullptr,
+    uint8_t* outcodes = nullptr
+);
+
+// Model space vertex -> camera space, as projectVertices
+inline fix16_vec3 transformPoint(const fix16_mat3x4& m, const fix16_vec3& p)
+{
+    return {
+        m.m[0][0]*p.x + m.m[0][1]*p.y + m.m[0][2]*p.z + m.t.x,
+        m.m[1][0]*p.x + m.m[1][1]*p.y + m.m[1][2]*p.z + m.t.y,
+        m.m[2][0]*p.x + m.m[2][1]*p.y + m.m[2][2]*p.z + m.t.z,
+    };
+}
+
+// Screen coordinate (and depth buffer value if inv_depth is not nullptr) of a
+// camera space point inside the clip volume
+int16_t_vec2 projectPoint(Fix16 FOV, const fix16_vec3& p, uint16_t* inv_depth);
+
+// ~~~~ Clipping ~~~~
+// Camera space planes for faces and lines with OUTCODE_CLIP vertices: the
+// near plane z = near and the guard band edges x = +-z*guard_slope_x (same
+// for y). What is left projects inside the guard band.
+
+struct fix16_clip_volume
+{
+    Fix16 near;
+    Fix16 guard_slope_x;
+    Fix16 guard_slope_y;
+};
+
+// Once per frame (depends on FOV only)
+fix16_clip_volume getClipVolume(Fix16 FOV);
+
+// Camera space position and texture coordinate
+struct clip_vertex
+{
+    fix16_vec3 pos;
+    Fix16 u;
+    Fix16 v;
+};
+
+// Triangle + one vertex per clip plane
+#define CLIP_MAX_VERTICES 8
+
+// Clips the convex polygon poly (count vertices) in place. poly and scratch
+// must hold CLIP_MAX_VERTICES. Returns the new vertex count, 0 if nothing is left.
+unsigned clipPolygon(const fix16_clip_volume& clip, clip_vertex* poly, unsigned count, clip_vertex* scratch);
+
+// Clips segment a-b in place. False if nothing is left.
+bool clipSegment(const fix16_clip_volume& clip, fix16_vec3& a, fix16_vec3& b);
+
+// Screen edges and depth range in camera space, for bounding sphere tests.
+// Each side plane goes through the camera: (x, z) . plane_x = 0 for the
+// camera x edges, same for y. Normals are unit length and point out.
+struct fix16_frustum
+{
+    fix16_vec2 plane_x;
+    fix16_vec2 plane_y;
+    Fix16      far_distance;
+};
+
+// Once per frame (depends on FOV only)
+fix16_frustum getViewFrustum(Fix16 FOV, Fix16 far_distance);
+
+// False if a sphere around model position is completely off screen, behind
+// the camera or beyond far_distance.
+bool isSphereVisible(
+    const fix16_frustum& frustum, const fix16_mat3x4& camera,
+    fix16_vec3 center, Fix16 radius
+);
@@ -0,0 +1,26 @@
+#pragma once
+
+// Render statistics counters (used by the headless benchmark build).
+// Compiled out completely when RENDER_STATS is not defined.
+
+#ifdef RENDER_STATS
+
+#include <cstdint>
+
+struct RenderStats
+{
+    uint32_t triangles_drawn;
+    uint32_t pixels_written;
+    uint32_t faces_culled;   // Back-facing, not sorted or drawn
+    uint32_t models_culled;  // Bounding sphere off screen, not transformed
+    uint32_t pixels_cleared; // Dirty rects cleared for the next frame
+};
+
+// Defined in RenderUtils.cpp. Reader is responsible for resetting.
+extern RenderStats render_stats;
+
+#   define RENDER_STATS_ADD(counter, amount) (render_stats.counter += (amount))
+#else
+    // Not evaluated, but locals only counted for the stats are still used
+#   define RENDER_STATS_ADD(counter, amount) ((void) sizeof(amount))
+#endif
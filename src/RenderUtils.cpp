@@ -4,6 +4,10 @@
 
 #include "RenderFP3D.hpp"
 
+#include "RenderStats.hpp"
+
+#include "DirtyRects.hpp"
+
 #ifndef PC
 #   include <sdk/os/lcd.h>
     // Global VRAM pointers
@@ -13,6 +17,12 @@
 #   include "PC_SDL_screen.hpp" // replaces "sdk/os/lcd.hpp"
 #endif
 
+#ifdef RENDER_STATS
+RenderStats render_stats = {0, 0, 0, 0, 0};
+#endif
+
+uint16_t* zbuffer = nullptr;
+
 // Light intensity range 1.0f - MIN_LIGHT_INTENSITY
 // It looks much better if colors wont go to full black
 #define MIN_LIGHT_INTENSITY 0.30f
@@ -49,117 +59,364 @@ Fix16 calculateLightIntensityDirLight  (const fix16_vec3& lightNormDir, const fi
     return intensity;
 }
 
-void drawHorizontalLine(
-    int x0, int x1, int y,
-    int u0, int u1, int v0, int v1,
-    uint32_t *texture, int textureWidth, int textureHeight,
-    Fix16 lightInstensity
-) {
-    if (x0 > x1) {
-        swap(x0, x1);
-        swap(u0, u1);
-        swap(v0, v1);
-    }
+// ~~~~~~~~~~~~~~~~ Shade tables ~~~~~~~~~~~~~~~~
+//
+// Lit texels are looked up instead of multiplied. Light intensity is
+// quantized to LIGHT_LEVELS steps and every level below full light has one
+// table: the shaded red (32), green (64) and blue (32) channel of an RGB565
+// texel, already in place as color_t. A lit pixel is three loads and two ORs.
 
-    if (x0 == x1) {
-        int u = u0;
-        int v = v0;
-
-        if (u >= 0 && u < textureWidth && v >= 0 && v < textureHeight) {
-            auto texel = texture[u + v * textureWidth];
-            uint8_t r = (0xff & (texel>>16));
-            uint8_t g = (0xff & (texel>>8));
-            uint8_t b = (0xff & texel);
-            r = (uint8_t) ((int16_t)(Fix16((int16_t)r) * lightInstensity));
-            g = (uint8_t) ((int16_t)(Fix16((int16_t)g) * lightInstensity));
-            b = (uint8_t) ((int16_t)(Fix16((int16_t)b) * lightInstensity));
-            auto c = color(r,g,b);
-            setPixel(x0, y, c);
-        }
-        return;
-    }
+#define SHADE_GREEN 32
+#define SHADE_BLUE  96
+#define SHADE_TABLE_SIZE 128
+
+static color_t shade_tables[LIGHT_LEVELS][SHADE_TABLE_SIZE];
 
-    for (int x = x0; x <= x1; x++) {
-        int alpha = (x - x0) * 65536 / (x1 - x0);
-        int u = ((u1 - u0) * alpha + u0 * 65536) >> 16;
-        int v = ((v1 - v0) * alpha + v0 * 65536) >> 16;
-
-        if (u >= 0 && u < textureWidth && v >= 0 && v < textureHeight) {
-            auto texel = texture[u + v * textureWidth];
-            uint8_t r = (0xff & (texel>>16));
-            uint8_t g = (0xff & (texel>>8));
-            uint8_t b = (0xff & texel);
-            r = (uint8_t) ((int16_t)(Fix16((int16_t)r) * lightInstensity));
-            g = (uint8_t) ((int16_t)(Fix16((int16_t)g) * lightInstensity));
-            b = (uint8_t) ((int16_t)(Fix16((int16_t)b) * lightInstensity));
-            auto c = color(r,g,b);
-            setPixel(x, y, c);
+void initShadeTables()
+{
+    for (uint32_t level = 0; level < LIGHT_LEVELS; level++) {
+        color_t* table = shade_tables[level];
+        for (uint32_t c = 0; c < 32; c++) {
+            table[c]              = texel_to_color((texel_t) (((c * level) / LIGHT_LEVELS) << 11));
+            table[SHADE_BLUE + c] = texel_to_color((texel_t) ((c * level) / LIGHT_LEVELS));
         }
+        for (uint32_t c = 0; c < 64; c++)
+            table[SHADE_GREEN + c] = texel_to_color((texel_t) (((c * level) / LIGHT_LEVELS) << 5));
     }
 }
 
-void drawTriangle(
-    int16_t_Point2d v0, int16_t_Point2d v1, int16_t_Point2d v2,
-    uint32_t *texture, int textureWidth, int textureHeight,
-    Fix16 lightInstensity
-) {
-    if (v0.y > v1.y) swap(v0, v1);
-    if (v0.y > v2.y) swap(v0, v2);
-    if (v1.y > v2.y) swap(v1, v2);
+static inline color_t lit_texel(texel_t texel, const color_t* table)
+{
+    return table[texel >> 11] | table[SHADE_GREEN + ((texel >> 5) & 0x3F)] | table[SHADE_BLUE + (texel & 0x1F)];
+}
 
-    int totalHeight = v2.y - v0.y;
+// ~~~~~~~~~~~~~~~~ Triangle rasterizer ~~~~~~~~~~~~~~~~
+//
+// Gradients of u, v and depth over the screen are set up once per triangle,
+// after that edges and attributes are only stepped (16.16 fixed point, no
+// divisions per scanline or pixel). Pixel centers are sampled at +0.5 with a
+// top-left fill rule: a pixel center exactly on a left or top edge is drawn,
+// on a right or bottom edge it is not. Triangles sharing an edge never draw
+// the same pixel twice or leave a gap between them.
+//
+// Setup (setupTriangle) and scanning (RasterTriangle::scan) are separate so
+// one setup can be scanned in parts, clipped to screen tiles (TileBinner).
+// Edges and attributes at the first scanline of a part are computed from the
+// vertex, the same values stepping from the top would reach.
+
+// Edge x at the center of the scanlines from a to b
+struct RasterEdge
+{
+    int32_t x;    // 16.16 at current scanline
+    int32_t step; // Per scanline
+};
 
-    // If triangle happens to be just a line, lets avoid it completely
-    if (totalHeight == 0) return;
+// Edge x per scanline from a to b (16.16), a.y < b.y
+static inline int32_t raster_edge_step(const int16_t_Point2d& a, const int16_t_Point2d& b)
+{
+    return ((int32_t) (b.x - a.x) << 16) / (b.y - a.y);
+}
 
-    // Drawing the upper part of the triangle
-    for (int y = v0.y; y <= v1.y; y++) {
-        int segmentHeight = v1.y - v0.y + 1;
-        int alpha = ((y - v0.y) << 16) / totalHeight;
-        int beta = ((y - v0.y) << 16) / segmentHeight;
+// Edge starting at a, at scanline y
+static inline RasterEdge raster_edge(const int16_t_Point2d& a, int32_t step, int y)
+{
+    RasterEdge e;
+    e.step = step;
+    e.x    = ((int32_t) a.x << 16) + e.step * (y - a.y) + e.step / 2;
+    return e;
+}
 
-        int x0 = v0.x + ((v2.x - v0.x) * alpha >> 16);
-        int x1 = v0.x + ((v1.x - v0.x) * beta >> 16);
+// First pixel whose center is at or right of x (16.16): ceil(x - 0.5)
+static inline int raster_pixel(int32_t x)
+{
+    return (x + 0x7FFF) >> 16;
+}
 
-        int u0 = v0.u + ((v2.u - v0.u) * alpha >> 16);
-        int u1 = v0.u + ((v1.u - v0.u) * beta >> 16);
+// Fix16 light intensity to a shade table level, LIGHT_LEVELS and up is unlit
+static inline uint32_t light_level(Fix16 light)
+{
+    if (light.value <= 0)
+        return 0;
+    if (light.value >= fix16_one)
+        return LIGHT_LEVELS;
+    return (uint32_t) light.value / (fix16_one / LIGHT_LEVELS);
+}
 
-        int v0_coord = v0.v + ((v2.v - v0.v) * alpha >> 16);
-        int v1_coord = v0.v + ((v1.v - v0.v) * beta >> 16);
+// (num << 16) / area2, saturated for slivers where it does not fit
+static inline int32_t raster_gradient(int32_t num, int32_t area2)
+{
+    return (Fix16((fix16_t) num) / Fix16((fix16_t) area2)).value;
+}
 
-        drawHorizontalLine(x0, x1, y, u0, u1, v0_coord, v1_coord, texture, textureWidth, textureHeight, lightInstensity);
+// LIT false writes texels straight through (light 1.0).
+// TILED must match texture.tiled.
+template <bool DEPTH_TEST, bool LIT, bool TILED>
+static uint32_t scan_triangle(const RasterTriangle& t, int clip_x0, int clip_y0, int clip_x1, int clip_y1)
+{
+    const int16_t_Point2d& v0 = t.v0;
+    const int32_t u_dx = t.u_dx, u_dy = t.u_dy;
+    const int32_t v_dx = t.v_dx, v_dy = t.v_dy;
+    const int32_t z_dx = t.z_dx, z_dy = t.z_dy;
+
+    // Clamp limits, or wrap masks when tiled (power of two)
+    const MipLevel& texture = *t.texture;
+    const int tex_max_u = texture.width  - 1;
+    const int tex_max_v = texture.height - 1;
+    const texel_t* texels = texture.texels;
+    const color_t* shade_table = t.shade_table;
+
+    uint32_t written = 0;
+    // Upper half (v0 -> v1) and lower half (v1 -> v2), long edge v0 -> v2 on one side
+    for (int half = 0; half < 2; half++) {
+        const int16_t_Point2d& a = half == 0 ? t.v0 : t.v1;
+        const int16_t_Point2d& b = half == 0 ? t.v1 : t.v2;
+        if (a.y == b.y)
+            continue;
+
+        // Scanlines whose center is inside [a.y, b.y), clipped
+        const int y_begin = a.y < clip_y0 ? clip_y0 : a.y;
+        const int y_end   = b.y > clip_y1 ? clip_y1 : b.y;
+        if (y_begin >= y_end)
+            continue;
+
+        RasterEdge long_edge  = raster_edge(t.v0, t.edge_step[0], y_begin);
+        RasterEdge short_edge = raster_edge(a, t.edge_step[1 + half], y_begin);
+        RasterEdge& left  = t.area2 > 0 ? long_edge  : short_edge;
+        RasterEdge& right = t.area2 > 0 ? short_edge : long_edge;
+
+        for (int y = y_begin; y < y_end; y++) {
+            int x_begin = raster_pixel(left.x);
+            int x_end   = raster_pixel(right.x);
+            left.x  += left.step;
+            right.x += right.step;
+            if (x_begin < clip_x0) x_begin = clip_x0;
+            if (x_end   > clip_x1) x_end   = clip_x1;
+            if (x_begin >= x_end)
+                continue;
+
+            const uint32_t offset_x = (uint32_t) (x_begin - v0.x);
+            const uint32_t offset_y = (uint32_t) (y - v0.y);
+            uint32_t u = t.u_origin + (uint32_t) u_dx * offset_x + (uint32_t) u_dy * offset_y;
+            uint32_t v = t.v_origin + (uint32_t) v_dx * offset_x + (uint32_t) v_dy * offset_y;
+            uint32_t z = t.z_origin + (uint32_t) z_dx * offset_x + (uint32_t) z_dy * offset_y;
+
+            color_t* row = screen_row(y);
+            uint16_t* z_row = DEPTH_TEST ? zbuffer + y * SCREEN_X : nullptr;
+            for (int x = x_begin; x < x_end; x++) {
+                int tex_u = (int32_t) u >> 16;
+                int tex_v = (int32_t) v >> 16;
+                u += u_dx;
+                v += v_dx;
+                if (DEPTH_TEST) {
+                    int depth = (int32_t) z >> 8;
+                    z += z_dx;
+                    if (depth > 65535) depth = 65535;
+                    if (depth <= z_row[x])
+                        continue;
+                    z_row[x] = depth;
+                    written++;
+                }
+                // Sampling at pixel centers can land just outside the uv triangle
+                texel_t texel;
+                if (TILED) {
+                    texel = texels[tiledTexelIndex(tex_u & tex_max_u, tex_v & tex_max_v, texture.width_log2)];
+                } else {
+                    if      (tex_u < 0)         tex_u = 0;
+                    else if (tex_u > tex_max_u) tex_u = tex_max_u;
+                    if      (tex_v < 0)         tex_v = 0;
+                    else if (tex_v > tex_max_v) tex_v = tex_max_v;
+                    texel = texels[tex_u + tex_v * texture.width];
+                }
+                row[x] = LIT ? lit_texel(texel, shade_table) : texel_to_color(texel);
+            }
+            if (!DEPTH_TEST)
+                written += x_end - x_begin;
+        }
     }
+    return written;
+}
 
-    // Drawing the lower part of the triangle
-    for (int y = v1.y + 1; y <= v2.y; y++) {
-        int segmentHeight = v2.y - v1.y + 1;
-        int alpha = ((y - v0.y) << 16) / totalHeight;
-        int beta = ((y - v1.y) << 16) / segmentHeight;
+// scan_triangle instance for depth test, light and texture layout
+template <bool DEPTH_TEST>
+static raster_scan_t pick_scan(bool lit, bool tiled)
+{
+    if (lit)
+        return tiled ? scan_triangle<DEPTH_TEST, true,  true> : scan_triangle<DEPTH_TEST, true,  false>;
+    return     tiled ? scan_triangle<DEPTH_TEST, false, true> : scan_triangle<DEPTH_TEST, false, false>;
+}
 
-        int x0 = v0.x + ((v2.x - v0.x) * alpha >> 16);
-        int x1 = v1.x + ((v2.x - v1.x) * beta >> 16);
+bool setupTriangle(
+    int16_t_Point2d v0, int16_t_Point2d v1, int16_t_Point2d v2,
+    int z0, int z1, int z2,
+    const MipLevel& texture,
+    Fix16 lightInstensity,
+    bool depth_test,
+    RasterTriangle& t
+) {
+    if (v0.y > v1.y) { swap(v0, v1); swap(z0, z1); }
+    if (v0.y > v2.y) { swap(v0, v2); swap(z0, z2); }
+    if (v1.y > v2.y) { swap(v1, v2); swap(z1, z2); }
+
+    // Twice the signed area. Positive when v1 is right of the long edge v0-v2.
+    const int32_t dx1 = v1.x - v0.x, dy1 = v1.y - v0.y;
+    const int32_t dx2 = v2.x - v0.x, dy2 = v2.y - v0.y;
+    const int32_t area2 = dx1 * dy2 - dx2 * dy1;
+    // Also catches a line (totalHeight 0)
+    if (area2 == 0) return false;
+
+    RENDER_STATS_ADD(triangles_drawn, 1);
+
+    // Pixels it can write: rows [v0.y, v2.y), columns between the vertices
+    int x_min = v0.x, x_max = v0.x;
+    if (v1.x < x_min) x_min = v1.x;
+    if (v2.x < x_min) x_min = v2.x;
+    if (v1.x > x_max) x_max = v1.x;
+    if (v2.x > x_max) x_max = v2.x;
+    t.x0 = (int16_t) (x_min < 0 ? 0 : x_min);
+    t.y0 = (int16_t) (v0.y  < 0 ? 0 : v0.y);
+    t.x1 = (int16_t) (x_max + 1 > SCREEN_X ? SCREEN_X : x_max + 1);
+    t.y1 = (int16_t) (v2.y  > SCREEN_Y ? SCREEN_Y : v2.y);
+    if (t.x0 >= t.x1 || t.y0 >= t.y1)
+        return false;
+
+    t.v0 = v0;
+    t.v1 = v1;
+    t.v2 = v2;
+    t.area2 = area2;
+    t.edge_step[0] = raster_edge_step(v0, v2);
+    t.edge_step[1] = v0.y == v1.y ? 0 : raster_edge_step(v0, v1);
+    t.edge_step[2] = v1.y == v2.y ? 0 : raster_edge_step(v1, v2);
+
+    // Attribute plane a(x, y) = a0 + a_dx * (x - x0) + a_dy * (y - y0)
+    t.u_dx = raster_gradient((v1.u - v0.u) * dy2 - (v2.u - v0.u) * dy1, area2);
+    t.u_dy = raster_gradient((v2.u - v0.u) * dx1 - (v1.u - v0.u) * dx2, area2);
+    t.v_dx = raster_gradient((v1.v - v0.v) * dy2 - (v2.v - v0.v) * dy1, area2);
+    t.v_dy = raster_gradient((v2.v - v0.v) * dx1 - (v1.v - v0.v) * dx2, area2);
+    // Depth in 24.8 (16 bit values would overflow 16.16)
+    t.z_dx = 0;
+    t.z_dy = 0;
+    if (depth_test) {
+        t.z_dx = raster_gradient((z1 - z0) * dy2 - (z2 - z0) * dy1, area2) >> 8;
+        t.z_dy = raster_gradient((z2 - z0) * dx1 - (z1 - z0) * dx2, area2) >> 8;
+    }
+    // At the center of pixel (x0, y0). Unsigned: partial sums may wrap, results do not.
+    t.u_origin = ((uint32_t) v0.u << 16) + (uint32_t) (t.u_dx / 2) + (uint32_t) (t.u_dy / 2);
+    t.v_origin = ((uint32_t) v0.v << 16) + (uint32_t) (t.v_dx / 2) + (uint32_t) (t.v_dy / 2);
+    t.z_origin = ((uint32_t) z0 << 8)    + (uint32_t) (t.z_dx / 2) + (uint32_t) (t.z_dy / 2);
+
+    const uint32_t level = light_level(lightInstensity);
+    t.texture     = &texture;
+    t.shade_table = level < LIGHT_LEVELS ? shade_tables[level] : nullptr;
+    t.scan = depth_test
+        ? pick_scan<true >(level < LIGHT_LEVELS, texture.tiled)
+        : pick_scan<false>(level < LIGHT_LEVELS, texture.tiled);
+    return true;
+}
 
-        int u0 = v0.u + ((v2.u - v0.u) * alpha >> 16);
-        int u1 = v1.u + ((v2.u - v1.u) * beta >> 16);
+void drawTriangle(
+    int16_t_Point2d v0, int16_t_Point2d v1, int16_t_Point2d v2,
+    const MipLevel& texture,
+    Fix16 lightInstensity
+) {
+    RasterTriangle t;
+    if (!setupTriangle(v0, v1, v2, 0, 0, 0, texture, lightInstensity, false, t))
+        return;
+    const uint32_t written = rasterizeTriangle(t, 0, 0, SCREEN_X, SCREEN_Y);
+    RENDER_STATS_ADD(pixels_written, written);
+}
+
+// ~~~~~~~~~~~~~~~~ Depth buffer ~~~~~~~~~~~~~~~~
+
+void setPixelDepth(int x, int y, uint16_t depth, color_t color)
+{
+    if (x < 0 || x >= SCREEN_X || y < 0 || y >= SCREEN_Y)
+        return;
+    uint16_t& z = zbuffer[y * SCREEN_X + x];
+    if (depth <= z)
+        return;
+    z = depth;
+    setPixel(x, y, color);
+}
 
-        int v0_coord = v0.v + ((v2.v - v0.v) * alpha >> 16);
-        int v1_coord = v1.v + ((v2.v - v1.v) * beta >> 16);
+void drawTriangleDepth(
+    int16_t_Point2d v0, int16_t_Point2d v1, int16_t_Point2d v2,
+    uint16_t z0, uint16_t z1, uint16_t z2,
+    const MipLevel& texture,
+    Fix16 lightInstensity
+) {
+    RasterTriangle t;
+    if (!setupTriangle(v0, v1, v2, z0, z1, z2, texture, lightInstensity, true, t))
+        return;
+    const uint32_t written = rasterizeTriangle(t, 0, 0, SCREEN_X, SCREEN_Y);
+    RENDER_STATS_ADD(pixels_written, written);
+}
 
-        drawHorizontalLine(x0, x1, y, u0, u1, v0_coord, v1_coord, texture, textureWidth, textureHeight, lightInstensity);
+// Bresenham like line() of PC_SDL_screen.cpp, depth stepped in 20.12 fixed point
+void lineDepth(int x1, int y1, uint16_t z1, int x2, int y2, uint16_t z2, color_t color)
+{
+    int ix, iy;
+    int dx = (x2>x1 ? (ix=1, x2-x1) : (ix=-1, x1-x2) );
+    int dy = (y2>y1 ? (iy=1, y2-y1) : (iy=-1, y1-y2) );
+    const int steps = dx >= dy ? dx : dy;
+    int z = (int) z1 << 12;
+    const int z_step = steps ? (((int) z2 - (int) z1) << 12) / steps : 0;
+
+    setPixelDepth(x1, y1, z1, color);
+    int error = 0;
+    if (dx >= dy) {
+        while (x1 != x2) {
+            x1 += ix;
+            error += dy;
+            if (error >= (dx>>1)) {
+                y1 += iy;
+                error -= dx;
+            }
+            z += z_step;
+            setPixelDepth(x1, y1, (uint16_t) (z >> 12), color);
+        }
+    } else {
+        while (y1 != y2) {
+            y1 += iy;
+            error += dx;
+            if (error >= (dy>>1)) {
+                x1 += ix;
+                error -= dy;
+            }
+            z += z_step;
+            setPixelDepth(x1, y1, (uint16_t) (z >> 12), color);
+        }
     }
 }
 
-void draw_center_square(int16_t cx, int16_t cy, int16_t sx, int16_t sy, color_t color)
+void draw_center_square_depth(int16_t cx, int16_t cy, int16_t sx, int16_t sy, uint16_t depth, color_t color)
 {
     for(int16_t i=-sx/2; i<sx/2; i++)
     {
         for(int16_t j=-sy/2; j<sy/2; j++)
         {
-            setPixel(cx+i, cy+j, color);
+            setPixelDepth(cx+i, cy+j, depth, color);
         }
     }
 }
 
+void draw_center_square(int16_t cx, int16_t cy, int16_t sx, int16_t sy, color_t color)
+{
+    fillRect(cx - sx/2, cy - sy/2, cx + sx/2, cy + sy/2, color);
+}
+
+void fillRect(int x0, int y0, int x1, int y1, color_t color)
+{
+    if (x0 < 0)        x0 = 0;
+    if (y0 < 0)        y0 = 0;
+    if (x1 > SCREEN_X) x1 = SCREEN_X;
+    if (y1 > SCREEN_Y) y1 = SCREEN_Y;
+    if (x0 >= x1 || y0 >= y1)
+        return;
+    for (int y = y0; y < y1; y++)
+        fillSpan(screen_row(y) + x0, x1 - x0, color);
+    RENDER_STATS_ADD(pixels_written, (x1 - x0) * (y1 - y0));
+}
+
 void draw_RotationVisualizer(fix16_vec2 camera_rot)
 {
 #ifdef LANDSCAPE_MODE
@@ -206,9 +463,24 @@ void draw_RotationVisualizer(fix16_vec2 camera_rot)
     const auto offset_y =            ROTATION_VISALIZER_EDGE_OFFSET + (int16_t) ROTATION_VISUALIZER_LINE_WIDTH;
 #endif
     // Draw actual lines
-    line(((int16_t) p_x.x)+offset_x,((int16_t) p_x.y)+offset_y, offset_x, offset_y, color(255,0,0));
-    line(((int16_t) p_y.x)+offset_x,((int16_t) p_y.y)+offset_y, offset_x, offset_y, color(0,255,0));
-    line(((int16_t) p_z.x)+offset_x,((int16_t) p_z.y)+offset_y, offset_x, offset_y, color(0,0,255));
+    const int16_t_vec2 ends[3] = {
+        {(int16_t) (((int16_t) p_x.x)+offset_x), (int16_t) (((int16_t) p_x.y)+offset_y)},
+        {(int16_t) (((int16_t) p_y.x)+offset_x), (int16_t) (((int16_t) p_y.y)+offset_y)},
+        {(int16_t) (((int16_t) p_z.x)+offset_x), (int16_t) (((int16_t) p_z.y)+offset_y)}
+    };
+    line(ends[0].x, ends[0].y, offset_x, offset_y, color(255,0,0));
+    line(ends[1].x, ends[1].y, offset_x, offset_y, color(0,255,0));
+    line(ends[2].x, ends[2].y, offset_x, offset_y, color(0,0,255));
+
+    // All lines start from the center, one rect around them
+    int x0 = offset_x, y0 = offset_y, x1 = offset_x, y1 = offset_y;
+    for (const auto& p : ends) {
+        if (x0 > p.x) x0 = p.x;
+        if (y0 > p.y) y0 = p.y;
+        if (x1 < p.x) x1 = p.x;
+        if (y1 < p.y) y1 = p.y;
+    }
+    dirty_rects.add(x0, y0, x1 + 1, y1 + 1);
 }
 
 void bubble_sort(uint_fix16_t a[], int n) {
@@ -217,3 +489,50 @@ void bubble_sort(uint_fix16_t a[], int n) {
             if (a[i - 1].fix16 < a[i].fix16)
                 swap(a[i - 1], a[i]);
 }
+
+// Key of one element: depth relative to the farthest face, scaled to 16 bits
+static inline uint32_t depth_sort_key(const uint_fix16_t& a, fix16_t max_depth, uint8_t shift) {
+    return ((uint32_t) max_depth - (uint32_t) a.fix16.value) >> shift;
+}
+
+void radix_sort_depth(uint_fix16_t a[], uint_fix16_t scratch[], int n) {
+    if (n < 2)
+        return;
+
+    // Depth range of the model decides the quantization (16 bit keys)
+    fix16_t min_depth = a[0].fix16.value;
+    fix16_t max_depth = a[0].fix16.value;
+    for (int i = 1; i < n; i++) {
+        if (a[i].fix16.value < min_depth) min_depth = a[i].fix16.value;
+        if (a[i].fix16.value > max_depth) max_depth = a[i].fix16.value;
+    }
+    uint32_t range = (uint32_t) max_depth - (uint32_t) min_depth;
+    uint8_t shift = 0;
+    while ((range >> shift) > 0xFFFF)
+        shift++;
+
+    // Both 8 bit digits counted in one pass
+    unsigned count_lo[256] = {0};
+    unsigned count_hi[256] = {0};
+    for (int i = 0; i < n; i++) {
+        const uint32_t key = depth_sort_key(a[i], max_depth, shift);
+        count_lo[key & 0xFF]++;
+        count_hi[key >> 8]++;
+    }
+    // Counts -> start offsets
+    unsigned sum_lo = 0, sum_hi = 0;
+    for (int d = 0; d < 256; d++) {
+        const unsigned c_lo = count_lo[d];
+        const unsigned c_hi = count_hi[d];
+        count_lo[d] = sum_lo;
+        count_hi[d] = sum_hi;
+        sum_lo += c_lo;
+        sum_hi += c_hi;
+    }
+
+    // Stable scatter: low digit into scratch, high digit back into a
+    for (int i = 0; i < n; i++)
+        scratch[count_lo[depth_sort_key(a[i], max_depth, shift) & 0xFF]++] = a[i];
+    for (int i = 0; i < n; i++)
+        a[count_hi[depth_sort_key(scratch[i], max_depth, shift) >> 8]++] = scratch[i];
+}
@@ -6,29 +6,211 @@
 #include "Fix16_Utils.hpp"
 
 #ifdef PC
+#   include <cstring> // memset
     typedef uint32_t color_t; // SDL2 uses 32b colors (24b colors + 8b alpha). Alpha not used.
+    extern uint32_t screenPixels[SCREEN_X * SCREEN_Y];
 #else
+#   include <string.h> // memset
     typedef uint16_t color_t; // ClassPad uses 16b colors
     extern uint16_t* vram;
     extern int width;
     extern int height;
 #endif
 
+// Row of the screen, no checks
+inline color_t* screen_row(int y)
+{
+#ifdef PC
+    return screenPixels + y * SCREEN_X;
+#else
+    return vram + y * width;
+#endif
+}
+
+// ~~~~~~~~~~~~~~~~ Span fill ~~~~~~~~~~~~~~~~
+// Rows are filled with the widest stores the value allows: memset when all
+// bytes are equal (depth 0, black, white), otherwise aligned 32 bit words
+// unrolled by 4. 16 bit spans (ClassPad VRAM, depth) store two pixels per word.
+
+// Word store into a 16 bit span
+typedef uint32_t __attribute__((__may_alias__)) fill_word_t;
+
+inline void fillSpan(uint16_t* dst, int count, uint16_t value)
+{
+    if (count <= 0)
+        return;
+    if ((value >> 8) == (value & 0xFF)) {
+        memset(dst, value & 0xFF, count * sizeof(uint16_t));
+        return;
+    }
+    if ((uintptr_t) dst & 2) {
+        *dst++ = value;
+        count--;
+    }
+    const uint32_t pair = ((uint32_t) value << 16) | value;
+    fill_word_t* words = reinterpret_cast<fill_word_t*>(dst);
+    int pairs = count >> 1;
+    for (; pairs >= 4; pairs -= 4, words += 4) {
+        words[0] = pair;
+        words[1] = pair;
+        words[2] = pair;
+        words[3] = pair;
+    }
+    for (; pairs > 0; pairs--)
+        *words++ = pair;
+    if (count & 1)
+        dst[count - 1] = value;
+}
+
+inline void fillSpan(uint32_t* dst, int count, uint32_t value)
+{
+    if (count <= 0)
+        return;
+    if (value == (value & 0xFF) * 0x01010101u) {
+        memset(dst, value & 0xFF, count * sizeof(uint32_t));
+        return;
+    }
+    for (; count >= 4; count -= 4, dst += 4) {
+        dst[0] = value;
+        dst[1] = value;
+        dst[2] = value;
+        dst[3] = value;
+    }
+    for (; count > 0; count--)
+        *dst++ = value;
+}
+
+// Fills x0 <= x < x1, y0 <= y < y1 clipped to the screen
+void fillRect(int x0, int y0, int x1, int y1, color_t color);
+
+// Textures are stored as RGB565 on both platforms (converted at load). On the
+// ClassPad that is color_t itself and texels go to VRAM unchanged.
+typedef uint16_t texel_t;
+
+inline texel_t rgb565(uint8_t r, uint8_t g, uint8_t b)
+{
+    return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+}
+
+// One texture (or one level of a mip chain). Power of two levels of at least
+// 4x4 are stored in 4x4 texel tiles when TILED_TEXTURES is defined: a tile is
+// 32 bytes, one SH4 cache line, so steep spans touch fewer lines than rows.
+// Tiled levels wrap (mask) instead of clamping texture coordinates.
+struct MipLevel {
+    texel_t* texels;
+    int      width;
+    int      height;
+    uint8_t  width_log2; // Only valid when tiled
+    bool     tiled;
+};
+
+inline uint32_t tiledTexelIndex(uint32_t x, uint32_t y, uint32_t width_log2)
+{
+    return ((y >> 2) << (width_log2 + 2)) + ((x >> 2) << 4) + ((y & 3) << 2) + (x & 3);
+}
+
+// Index of texel (x, y) in texture.texels for either layout
+inline uint32_t texelIndex(const MipLevel& texture, uint32_t x, uint32_t y)
+{
+    return texture.tiled ? tiledTexelIndex(x, y, texture.width_log2) : y * texture.width + x;
+}
+
+inline color_t texel_to_color(texel_t texel)
+{
+#ifdef PC
+    // Widen 5/6/5 to 8 bit channels, top bits repeated so white stays white
+    const uint32_t r = texel >> 11, g = (texel >> 5) & 0x3F, b = texel & 0x1F;
+    return ((r << 3 | r >> 2) << 16) | ((g << 2 | g >> 4) << 8) | (b << 3 | b >> 2);
+#else
+    return texel;
+#endif
+}
+
+// Depth plane beside the screen (SCREEN_X * SCREEN_Y) when the renderer uses
+// a depth buffer, nullptr otherwise. Larger is closer, 0 is cleared.
+extern uint16_t* zbuffer;
+
 Fix16 calculateLightIntensityPointLight(const fix16_vec3& lightPos,     const fix16_vec3& surfacePos, const fix16_vec3& normal, Fix16 lightIntensity);
 Fix16 calculateLightIntensityDirLight  (const fix16_vec3& lightNormDir, const fix16_vec3& surfaceNorm, Fix16 lightIntensity);
 
-void drawHorizontalLine(
-    int x0, int x1, int y,
-    int u0, int u1, int v0, int v1,
-    uint32_t *texture, int textureWidth, int textureHeight,
-    Fix16 lightInstensity = 1.0f
+// Lit texturing quantizes light intensity to this many levels (power of two)
+#define LIGHT_LEVELS 32
+
+// Builds the per-level shade tables of lit texturing. Call once before drawing.
+void initShadeTables();
+
+// ~~~~ Incremental scanline rasterizer with top-left fill rule (see RenderUtils.cpp) ~~~~
+// Vertices may be up to GUARD_BAND pixels outside the screen.
+
+struct RasterTriangle;
+
+// Draws the pixels of t inside [x0, x1) x [y0, y1), returns how many were written
+typedef uint32_t (*raster_scan_t)(const RasterTriangle& t, int x0, int y0, int x1, int y1);
+
+// Triangle after setup, can be scanned in parts (any clip rects) later
+struct RasterTriangle {
+    raster_scan_t   scan;        // Instance for depth test, light and texture layout
+    const MipLevel* texture;     // Must stay valid until scanned
+    const color_t*  shade_table; // nullptr when unlit
+    int16_t_Point2d v0, v1, v2;  // Sorted by y
+    int32_t  area2;
+    int32_t  edge_step[3];       // 16.16 x per scanline of v0-v2, v0-v1, v1-v2
+    int32_t  u_dx, u_dy, v_dx, v_dy, z_dx, z_dy;
+    uint32_t u_origin, v_origin, z_origin;
+    int16_t  x0, y0, x1, y1;     // Screen area it may write to (half-open)
+};
+
+// Returns false when there is nothing to draw (degenerate or off screen).
+// z0..z2 (inv_depths) are only used with depth_test.
+bool setupTriangle(
+    int16_t_Point2d v0, int16_t_Point2d v1, int16_t_Point2d v2,
+    int z0, int z1, int z2,
+    const MipLevel& texture,
+    Fix16 lightInstensity,
+    bool depth_test,
+    RasterTriangle& t
 );
 
+inline uint32_t rasterizeTriangle(const RasterTriangle& t, int x0, int y0, int x1, int y1)
+{
+    return t.scan(t, x0, y0, x1, y1);
+}
+
+// Setup and scan of the whole screen right away
 void drawTriangle(
     int16_t_Point2d v0, int16_t_Point2d v1, int16_t_Point2d v2,
-    uint32_t *texture, int textureWidth, int textureHeight,
+    const MipLevel& texture,
     Fix16 lightInstensity = 1.0f
 );
+
+// ~~~~ Depth tested versions (zbuffer must be allocated) ~~~~
+// depth values come from projectVertices inv_depths
+
+void setPixelDepth(int x, int y, uint16_t depth, color_t color);
+
+void drawTriangleDepth(
+    int16_t_Point2d v0, int16_t_Point2d v1, int16_t_Point2d v2,
+    uint16_t z0, uint16_t z1, uint16_t z2,
+    const MipLevel& texture,
+    Fix16 lightInstensity = 1.0f
+);
+
+void lineDepth(int x1, int y1, uint16_t z1, int x2, int y2, uint16_t z2, color_t color);
+
+void draw_center_square_depth(int16_t cx, int16_t cy, int16_t sx, int16_t sy, uint16_t depth, color_t color);
+
+// Twice the signed area of a triangle, negative when counter-clockwise on screen
+inline int32_t triangleArea2(int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t x2, int32_t y2)
+{
+    return (x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0);
+}
+
+// Winding of the projected triangle. Degenerate (zero area) faces count as back-facing.
+inline bool isBackFacing(int16_t_vec2 v0, int16_t_vec2 v1, int16_t_vec2 v2)
+{
+    return triangleArea2(v0.x, v0.y, v1.x, v1.y, v2.x, v2.y) >= 0;
+}
+
 void draw_center_square(int16_t cx, int16_t cy, int16_t sx, int16_t sy, color_t color);
 
 void draw_RotationVisualizer(fix16_vec2 camera_rot);
@@ -41,3 +223,7 @@ inline void swap(T& a, T& b) {
 }
 
 void bubble_sort(uint_fix16_t a[], int n);
+
+// Farthest first, like bubble_sort but O(n): stable 2 pass radix sort on
+// 16 bit keys quantized from the depth range of a. scratch must hold n items.
+void radix_sort_depth(uint_fix16_t a[], uint_fix16_t scratch[], int n);
@@ -6,21 +6,35 @@
 
 #include "RenderUtils.hpp"
 
+#include "Profiler.hpp"
+
+#include "RenderStats.hpp"
+
+#include "DirtyRects.hpp"
+
+#include "TileBinner.hpp"
+
 #ifndef PC
 #   include <sdk/os/lcd.h>
 #   include <sdk/calc/calc.h>
 #   include <sdk/os/input.h>
+#   include <sdk/os/mem.h>
+#   include <string.h> // memset
     extern uint16_t* vram;
     extern int width;
     extern int height;
 #else
 #   include "PC_SDL_screen.hpp" // replaces "sdk/os/lcd.hpp"
+#   include <cstdlib>
+#   include <cstring> // memset
 #endif
 
 Renderer::Renderer()
 :   camera_pos({-15.0f, -1.6f, -15.0f}),
     camera_rot({0.6f, 0.4f}),
     FOV(150.0f),
+    far_distance(FAR_DISTANCE_DEFAULT),
+    z_buffer(Z_BUFFER_DEFAULT),
     lightPos({0.0f, 0.0f, 0.0f}),
     directionalLightDir({0.0f, -0.7071f, 0.7071f}),
     minimapPos({0, 0}),
@@ -28,6 +42,8 @@ Renderer::Renderer()
 {
     directionalLightDir = {-1.0f, -0.5f, 0.0f};
     normalize_fix16_vec3(directionalLightDir);
+
+    initShadeTables();
 }
 
 #ifdef PC
@@ -40,6 +56,10 @@ Renderer::~Renderer()
     for (auto& it : modelArray) {
         delete it.first;
     }
+    if (zbuffer) {
+        free(zbuffer);
+        zbuffer = nullptr;
+    }
 }
 
 //DynamicArray<Pair<Model*, Fix16>>& Renderer::getModelArray()
@@ -54,6 +74,10 @@ Model* Renderer::addModel(char* model_path, char* texture_path, bool centerVerti
     // Create new object
     auto m = new Model(model_path, texture_path, centerVertices);
     modelArray.push_back({m, 0.0f});
+    // Scratch of the most expensive render mode, with or without depth buffer
+    const uint32_t sorting = modelFrameBytes(m, RENDER_MODES::TEXTURED_LIGHT, false);
+    const uint32_t depth   = modelFrameBytes(m, RENDER_MODES::TEXTURED_LIGHT, true);
+    frame_arena.reserve(sorting > depth ? sorting : depth);
     // Return pointer back for reference
     return m;
 }
@@ -72,14 +96,26 @@ fix16_vec2& Renderer::get_camera_rot(){
 Fix16& Renderer::get_FOV(){
     return FOV;
 }
+Fix16& Renderer::get_farDistance(){
+    return far_distance;
+}
+bool& Renderer::get_zBuffer(){
+    return z_buffer;
+}
 fix16_vec3& Renderer::get_lightPos(){
     return lightPos;
 }
+FrameArena& Renderer::get_frameArena(){
+    return frame_arena;
+}
+TileBinner& Renderer::get_tileBinner(){
+    return tile_binner;
+}
 int16_t_vec2& Renderer::get_minimapPos(){
     return minimapPos;
 }
 
-#ifdef PC
+#if defined(PC) && !defined(HEADLESS)
 int Renderer::custom_sdl2_init(SDL_Window **window, SDL_Renderer **sdl_renderer, SDL_Texture ** texture)
 {
     if (SDL_Init(SDL_INIT_EVERYTHING) != 0)
@@ -114,123 +150,82 @@ int Renderer::custom_sdl2_init(SDL_Window **window, SDL_Renderer **sdl_renderer,
 
     *texture = _texture;
 
+    // Texture starts undefined, first present uploads everything
+    present_rects.add(0, 0, SCREEN_X, SCREEN_Y);
+
     return 0;
 }
 #endif
 
-void Renderer::screen_flush()
+#if defined(PC) && !defined(HEADLESS)
+// Uploads only what changed since the last present: drawn this frame, or
+// drawn the frame before and cleared after that present
+void Renderer::present_dirty()
 {
-#ifndef PC
-    LCD_Refresh();
-    // Get VRAM and Size ONCE per frame
-    vram = (uint16_t*)LCD_GetVRAMAddress();
-    LCD_GetSize(&width, &height);
-#else
-    SDL_UpdateTexture(_texture, NULL, screenPixels, SCREEN_X * sizeof(Uint32));
-    SDL_RenderClear(_sdl_renderer);
-
-    #ifdef LANDSCAPE_MODE
-    // I have no idea how this rotation works but it does..
-    SDL_Rect srcrect;
-    SDL_Rect dstrect;
-    auto sx = (int) ((float) SCREEN_X * (float) WINDOW_SIZE_MULTIPLIER);
-    auto sy = (int) ((float) SCREEN_Y * (float) WINDOW_SIZE_MULTIPLIER);
-    srcrect.x = 0;
-    srcrect.y = 0;
-    srcrect.w = sy;
-    srcrect.h = sx;
-    dstrect.x = 0;
-    dstrect.y = sx;
-    dstrect.w = sx;
-    dstrect.h = sy;
-    SDL_Point rotationCenter = {0, 0};
-    SDL_RenderCopyEx(_sdl_renderer, _texture, &srcrect, &dstrect, -90.0, &rotationCenter, SDL_FLIP_NONE);
-    #else
-    SDL_RenderCopyEx(_sdl_renderer, _texture, NULL, NULL,   0.0, NULL, SDL_FLIP_NONE);
-    #endif
-
-    SDL_RenderPresent(_sdl_renderer);
+    for (unsigned i = 0; i < dirty_rects.get_count(); i++) {
+        const DirtyRect& r = dirty_rects.get_rect(i);
+        present_rects.add(r.x0, r.y0, r.x1, r.y1);
+    }
+    for (unsigned i = 0; i < present_rects.get_count(); i++) {
+        const DirtyRect& r = present_rects.get_rect(i);
+        const SDL_Rect rect = {r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0};
+        SDL_UpdateTexture(_texture, &rect, screenPixels + r.y0 * SCREEN_X + r.x0, SCREEN_X * sizeof(Uint32));
+    }
+    // Cleared after this present, so different again at the next one
+    present_rects = dirty_rects;
+}
 #endif
 
-#ifdef CLEAR_FULL_SCREEN
-    fillScreen(FILL_SCREEN_COLOR);
-#else
-
-#ifdef PER_MODEL_CLEAR
-    // FOR EACH MODEL
-    // unsigned models_to_draw =  modelArray.getSize()/2;
-    // int skip_first_models = modelArray.getSize() - models_to_draw;
-    for (auto& it : modelArray) {
-
-        // if(skip_first_models >= 0) {
-        //     skip_first_models -= 1;
-        //     continue;
-        // }
+void Renderer::screen_flush()
+{
+    {
+        PROFILE_ZONE(PROF_PRESENT);
+#ifndef PC
+        LCD_Refresh();
+        // Get VRAM and Size ONCE per frame
+        vram = (uint16_t*)LCD_GetVRAMAddress();
+        LCD_GetSize(&width, &height);
+#elif !defined(HEADLESS)
+        present_dirty();
+        SDL_RenderClear(_sdl_renderer);
+
+        #ifdef LANDSCAPE_MODE
+        // The window is scaled from the texture in any case, turning it in the
+        // same copy costs nothing on the GPU. Turning dirty rects on the CPU
+        // (landscape texture) was 4-5x slower than uploading them as they are.
+        // I have no idea how this rotation works but it does..
+        SDL_Rect srcrect;
+        SDL_Rect dstrect;
+        auto sx = (int) ((float) SCREEN_X * (float) WINDOW_SIZE_MULTIPLIER);
+        auto sy = (int) ((float) SCREEN_Y * (float) WINDOW_SIZE_MULTIPLIER);
+        srcrect.x = 0;
+        srcrect.y = 0;
+        srcrect.w = sy;
+        srcrect.h = sx;
+        dstrect.x = 0;
+        dstrect.y = sx;
+        dstrect.w = sx;
+        dstrect.h = sy;
+        SDL_Point rotationCenter = {0, 0};
+        SDL_RenderCopyEx(_sdl_renderer, _texture, &srcrect, &dstrect, -90.0, &rotationCenter, SDL_FLIP_NONE);
+        #else
+        SDL_RenderCopyEx(_sdl_renderer, _texture, NULL, NULL,   0.0, NULL, SDL_FLIP_NONE);
+        #endif
 
-        // Bounding box per model
-        auto& bbox_max = it.first->getBoundBox_max();
-        auto& bbox_min = it.first->getBoundBox_min();
+        SDL_RenderPresent(_sdl_renderer);
 #endif
-        // Clear models
-        for(int x=bbox_min.x; x<bbox_max.x; x++){
-            for(int y=bbox_min.y; y<bbox_max.y; y++){
-                // UNSAFE Pixel setting (not checking if the pixel is inside)
-                #ifdef PC
-                    setPixel_Unsafe(x,y, FILL_SCREEN_COLOR);
-                #else
-                    vram[width*y + x] = FILL_SCREEN_COLOR;
-                #endif
-            }
-        }
-#ifdef PER_MODEL_CLEAR
-        // Reset the bound box
-        bbox_max = {0, 0};
-        bbox_min = {SCREEN_X, SCREEN_Y};
     }
-#endif // PER_MODEL_CLEAR
 
-        // Clear FPS Text (only for pc as pc draws on screen differently)
-    #ifdef PC
-            for(int x=10; x < 50; x++){
-                for(int y=10; y < 6*4; y++){
-                    setPixel_Unsafe(x,y, FILL_SCREEN_COLOR);
-                }
-            }
-    #endif
+    PROFILE_ZONE(PROF_CLEAR);
 
-    #ifdef LANDSCAPE_MODE
-        // Clear rotation visualizer
-        for(int x=SCREEN_X-ROTATION_VISUALIZER_LINE_WIDTH*2-ROTATION_VISALIZER_EDGE_OFFSET; x<SCREEN_X; x++){
-            for(int y=SCREEN_Y-ROTATION_VISUALIZER_LINE_WIDTH*2-ROTATION_VISALIZER_EDGE_OFFSET; y<=SCREEN_Y; y++){
-    #else
-        // Clear rotation visualizer
-        for(int x=SCREEN_X-ROTATION_VISUALIZER_LINE_WIDTH*2-ROTATION_VISALIZER_EDGE_OFFSET; x<SCREEN_X; x++){
-            for(int y=0; y<=ROTATION_VISUALIZER_LINE_WIDTH*2+ROTATION_VISALIZER_EDGE_OFFSET; y++){
-    #endif
-    #ifdef PC
-                setPixel_Unsafe(x,y, FILL_SCREEN_COLOR);
-    #else
-                vram[width*y + x] = FILL_SCREEN_COLOR;
-    #endif
-            }
-        }
+    // Scratch buffers of update() are not needed anymore
+    frame_arena.reset();
 
-#endif // !CLEAR_FULL_SCREEN
-
-    // Clear minimap
-    draw_Minimap(true);
-}
-
-inline void draw_box(int size, int x, int y, color_t colorr)
-{
-    for(int16_t i=-size/2; i<size/2; i++) {
-        for(int16_t j=-size/2; j<size/2; j++) {
-            setPixel(x+i, y+j, colorr);
-        }
-    }
+    // Everything drawn since the last flush, each pixel once
+    dirty_rects.clear(FILL_SCREEN_COLOR);
 }
 
-void Renderer::draw_Minimap(bool clear)
+void Renderer::draw_Minimap()
 {
 #ifdef LANDSCAPE_MODE
     const auto edge_offset = 5;
@@ -251,9 +246,8 @@ void Renderer::draw_Minimap(bool clear)
     const auto x4 = x3;
     const auto y4 = y1;
 
-    color_t colorr;
-    if(clear) colorr = FILL_SCREEN_COLOR;
-    else      colorr = color(12,12,32);
+    const color_t colorr = color(12,12,32);
+    dirty_rects.add(x3, y1, x1 + 1, y2 + 1);
 
     // Draw edges
     line(x1, y1, x2, y2, colorr);
@@ -290,10 +284,7 @@ void Renderer::draw_Minimap(bool clear)
         if(x3+dot_size/2 > x || x >=x1-dot_size/2 || y1+dot_size/2 > y || y >=y2-dot_size/2)
             continue;
         // Draw square of size sx,sy at loaction x,y
-        color_t model_color;
-        if(clear) model_color = FILL_SCREEN_COLOR;
-        else      model_color = it.first->color;
-        draw_box(dot_size, x, y, model_color);
+        draw_center_square(x, y, dot_size, dot_size, it.first->color);
     }
 #else
 
@@ -304,392 +295,530 @@ bool modelArrayCompare(const Pair<Model*, Fix16>& a, const Pair<Model*, Fix16>&
     return a.second < b.second;
 }
 
-void Renderer::update()
+static inline void grow_bbox(int16_t_vec2& bbox_min, int16_t_vec2& bbox_max, int16_t_vec2 p)
 {
+    if (bbox_max.x < p.x) bbox_max.x = p.x;
+    if (bbox_max.y < p.y) bbox_max.y = p.y;
+    if (bbox_min.x > p.x) bbox_min.x = p.x;
+    if (bbox_min.y > p.y) bbox_min.y = p.y;
+}
 
-#ifndef PER_MODEL_CLEAR
-    bbox_max = {0, 0};
-    bbox_min = {SCREEN_X, SCREEN_Y};
-#endif
+void Renderer::drawClippedFace(
+    Model* model, unsigned f_id, const fix16_mat3x4& model_view, const fix16_clip_volume& clip,
+    Fix16 light, int16_t_vec2& bbox_min, int16_t_vec2& bbox_max
+) {
+    const unsigned vertex_ids[3] = {model->faces[f_id].First, model->faces[f_id].Second, model->faces[f_id].Third};
+    const unsigned uv_ids[3]     = {model->uv_faces[f_id].First, model->uv_faces[f_id].Second, model->uv_faces[f_id].Third};
+    const Fix16 tex_w = (int16_t) model->gen_textureWidth;
+    const Fix16 tex_h = (int16_t) model->gen_textureHeight;
+
+    clip_vertex poly[CLIP_MAX_VERTICES];
+    clip_vertex scratch[CLIP_MAX_VERTICES];
+    for (unsigned i = 0; i < 3; i++) {
+        const fix16_vec2& uv = model->uv_coords[uv_ids[i]];
+        poly[i] = {transformPoint(model_view, model->vertices[vertex_ids[i]]), uv.x * tex_w, uv.y * tex_h};
+    }
+    const unsigned count = clipPolygon(clip, poly, 3, scratch);
+    if (count < 3)
+        return;
+
+    int16_t_Point2d screen[CLIP_MAX_VERTICES];
+    uint16_t inv_depths[CLIP_MAX_VERTICES];
+    for (unsigned i = 0; i < count; i++) {
+        const int16_t_vec2 p = projectPoint(FOV, poly[i].pos, z_buffer ? &inv_depths[i] : nullptr);
+        screen[i] = {p.x, p.y, (int16_t) poly[i].u, (int16_t) poly[i].v};
+    }
 
-    // TODO: Different RENDER_MODEs have a lot in common and could therefore be
-    //       combined for cleaner code. BUT cleaner code does not mean faster code here
-    //       as we would want to avoid doing bunch of if checks if possible.
-    //       -> Too lazy right now to figure this out..
+    // Whole polygon is in front of the camera now, winding can be trusted
+    int32_t screen_area2 = 0;
+    int32_t uv_area2 = 0;
+    for (unsigned i = 1; i + 1 < count; i++) {
+        const int16_t_Point2d& a = screen[0];
+        const int16_t_Point2d& b = screen[i];
+        const int16_t_Point2d& c = screen[i + 1];
+        screen_area2 += triangleArea2(a.x, a.y, b.x, b.y, c.x, c.y);
+        uv_area2     += triangleArea2(a.u, a.v, b.u, b.v, c.u, c.v);
+    }
+    if (model->cull_backfaces && screen_area2 >= 0) {
+        RENDER_STATS_ADD(faces_culled, 1);
+        return;
+    }
 
-    if (camera_move_dirty)
-    {
-        camera_move_dirty = false;
-        // Sort all models in order from camera. A cheap way to have alteast
-        // some kind of order between models. Correct way would be to do this
-        // per triangle but calculating square root per triangle takes long time
-        // -> Accepting tradeoff of accuracy to gain speed.
+    const unsigned mip = model->selectMipLevel(uv_area2, screen_area2);
+    const MipLevel& texture = model->mip_levels[mip];
+    for (unsigned i = 0; i < count; i++) {
+        screen[i].u >>= mip;
+        screen[i].v >>= mip;
+        grow_bbox(bbox_min, bbox_max, {screen[i].x, screen[i].y});
+    }
+    // Convex polygon as a triangle fan
+    for (unsigned i = 1; i + 1 < count; i++) {
+        if (z_buffer)
+            tile_binner.addTriangleDepth(screen[0], screen[i], screen[i + 1], inv_depths[0], inv_depths[i], inv_depths[i + 1], texture, light);
+        else
+            tile_binner.addTriangle(screen[0], screen[i], screen[i + 1], texture, light);
+    }
+}
 
-        // TODO: MAKE THIS DISTANCE ALSO TAKE INTO ACCOUNT IS IT VISIBLE OR NOT!!
-        //
-        unsigned i = 0;
-        for (auto& it : modelArray) {
-            Model* m = it.first;
-            Fix16 dist = calculateDistance(m->getPosition_ref(), camera_pos);
-            it.second = dist;
-            i++;
-        }
+void Renderer::drawClippedLine(
+    Model* model, const fix16_mat3x4& model_view, const fix16_clip_volume& clip,
+    unsigned v_a, unsigned v_b, int16_t_vec2& bbox_min, int16_t_vec2& bbox_max
+) {
+    fix16_vec3 a = transformPoint(model_view, model->vertices[v_a]);
+    fix16_vec3 b = transformPoint(model_view, model->vertices[v_b]);
+    if (!clipSegment(clip, a, b))
+        return;
+    uint16_t z_a, z_b;
+    const int16_t_vec2 sa = projectPoint(FOV, a, &z_a);
+    const int16_t_vec2 sb = projectPoint(FOV, b, &z_b);
+    grow_bbox(bbox_min, bbox_max, sa);
+    grow_bbox(bbox_min, bbox_max, sb);
+    if (z_buffer)
+        lineDepth(sa.x, sa.y, z_a, sb.x, sb.y, z_b, model->color);
+    else
+        line(sa.x, sa.y, sb.x, sb.y, model->color);
+}
 
-        // Sort by camera distance (in reverse order).
-        //sort_modelRenderOrder(modelArray.getRawArray(), modelArray.getSize());
-        modelArray.sort(modelArrayCompare);
+// ~~~~~~~~~~~~~~~~ Per-model stages of update() ~~~~~~~~~~~~~~~~
+//
+// A visible model is transformed (vertices to screen, bounding box), its
+// faces ordered (visibility, depth sort, light) and then drawn. The first
+// two only read the model and write its ModelFrame. The calculator runs the
+// stages one model at a time with the scratch of one model in frame_arena.
+// PC with more than one thread runs them as jobs for all models at once
+// (large meshes split into vertex ranges) and then draws in model order.
+
+// Skips models off screen and textured modes of models without texture
+bool Renderer::modelVisible(Model* model, const fix16_mat3x4& camera_matrix, const fix16_frustum& frustum)
+{
+    const auto& scale = model->getScale_ref();
+    Fix16 max_scale = Fix16(fix16_abs(scale.x));
+    if (max_scale < Fix16(fix16_abs(scale.y))) max_scale = Fix16(fix16_abs(scale.y));
+    if (max_scale < Fix16(fix16_abs(scale.z))) max_scale = Fix16(fix16_abs(scale.z));
+    model->frustum_culled = !isSphereVisible(
+        frustum, camera_matrix, model->getPosition_ref(), model->encapsulating_radius * max_scale
+    );
+    if (model->frustum_culled) {
+        RENDER_STATS_ADD(models_culled, 1);
+        return false;
+    }
+    // Next mode from the next frame on
+    if (model->render_mode >= RENDER_MODES::TEXTURED && !model->has_texture) {
+        if (model->render_mode == RENDER_MODES::TEXTURED)
+            model->render_mode++;
+        else
+            model->render_mode = 0;
+        return false;
     }
+    return true;
+}
 
-    bool is_valid;
-    // unsigned models_to_draw =  modelArray.getSize()/2;
-    // int skip_first_models = modelArray.getSize() - models_to_draw;
-    for (auto& it : modelArray) {
+uint32_t Renderer::modelFrameBytes(const Model* model, uint16_t render_mode, bool depth)
+{
+    const unsigned vertices = model->vertex_count;
+    const unsigned faces    = model->faces_count;
+    uint32_t bytes = FrameArena::size_of<int16_t_vec2>(vertices);
+    if (depth)
+        bytes += FrameArena::size_of<uint16_t>(vertices);
+    if (render_mode != RENDER_MODES::POINT_CLOUD)
+        bytes += FrameArena::size_of<uint8_t>(vertices);
+    if (render_mode >= RENDER_MODES::TEXTURED) {
+        bytes += FrameArena::size_of<Fix16>(vertices) + FrameArena::size_of<uint_fix16_t>(faces);
+        // Radix sort scratch
+        if (!depth)
+            bytes += FrameArena::size_of<uint_fix16_t>(faces);
+    }
+    return bytes;
+}
 
-        // if(skip_first_models >= 0) {
-        //     skip_first_models -= 1;
-        //     continue;
-        // }
+void Renderer::beginModelFrame(ModelFrame& frame, Model* model, const fix16_mat3x4& camera_matrix)
+{
+    const uint16_t render_mode = model->render_mode;
+    const bool textured = render_mode >= RENDER_MODES::TEXTURED;
+    const unsigned vertices = model->vertex_count;
+    const unsigned faces    = model->faces_count;
+
+    frame.model       = model;
+    frame.render_mode = render_mode;
+    frame.model_view  = getModelViewMatrix(
+        camera_matrix,
+        model->getPosition_ref(), model->getRotation_ref(), model->getScale_ref()
+    );
+    frame.screen_coords   = frame_arena.alloc<int16_t_vec2>(vertices);
+    frame.vert_z_depths   = textured ? frame_arena.alloc<Fix16>(vertices) : nullptr;
+    frame.inv_depths      = z_buffer ? frame_arena.alloc<uint16_t>(vertices) : nullptr;
+    frame.outcodes        = render_mode != RENDER_MODES::POINT_CLOUD ? frame_arena.alloc<uint8_t>(vertices) : nullptr;
+    frame.face_draw_order = textured ? frame_arena.alloc<uint_fix16_t>(faces) : nullptr;
+    frame.sort_scratch    = textured && !z_buffer ? frame_arena.alloc<uint_fix16_t>(faces) : nullptr;
+    frame.face_light      = nullptr;
+    frame.visible_faces   = 0;
+    frame.faces_culled    = 0;
+    frame.bbox_min = {SCREEN_X, SCREEN_Y};
+    frame.bbox_max = {0, 0};
+}
 
-        auto RENDER_MODE = it.first->render_mode;
-        #ifdef PER_MODEL_CLEAR
-        auto& bbox_max = it.first->getBoundBox_max();
-        auto& bbox_min = it.first->getBoundBox_min();
-        #endif
+void Renderer::transformVertices(
+    const ModelFrame& frame, unsigned begin, unsigned end, int16_t_vec2& bbox_min, int16_t_vec2& bbox_max
+) const {
+    projectVertices(
+        frame.model_view, FOV, frame.model->vertices + begin, end - begin,
+        frame.screen_coords + begin,
+        frame.vert_z_depths ? frame.vert_z_depths + begin : nullptr,
+        frame.inv_depths    ? frame.inv_depths    + begin : nullptr,
+        frame.outcodes      ? frame.outcodes      + begin : nullptr
+    );
+    // Points are squares around the vertex
+    const int16_t margin = frame.render_mode == RENDER_MODES::POINT_CLOUD ? 2 : 0;
+    for (unsigned v_id = begin; v_id < end; v_id++) {
+        int16_t x = frame.screen_coords[v_id].x;
+        int16_t y = frame.screen_coords[v_id].y;
+        // Check bbox
+        if (x == (int16_t) -999)
+            continue;
+        if (bbox_max.x < x + margin) bbox_max.x = x + margin;
+        if (bbox_max.y < y + margin) bbox_max.y = y + margin;
+        if (bbox_min.x > x - margin) bbox_min.x = x - margin;
+        if (bbox_min.y > y - margin) bbox_min.y = y - margin;
+    }
+}
 
-        // Point-cloud
-        if (RENDER_MODE == RENDER_MODES::POINT_CLOUD){
-            Fix16 fix16_sink;
-
-            // Get screen coordinates
-            for (unsigned v_id=0; v_id<it.first->vertex_count; v_id++){
-                fix16_vec2 screen_vec2;
-                screen_vec2 = getScreenCoordinate(
-                    FOV, it.first->vertices[v_id],
-                    it.first->getPosition_ref(), it.first->getRotation_ref(),
-                    it.first->getScale_ref(),
-                    camera_pos, camera_rot,
-                    &fix16_sink, &is_valid
-                );
-                if(is_valid == false)
-                    continue;
-                int16_t x = (int16_t)screen_vec2.x;
-                int16_t y = (int16_t)screen_vec2.y;
+void Renderer::orderFaces(ModelFrame& frame) const
+{
+    if (frame.render_mode < RENDER_MODES::TEXTURED)
+        return;
+    Model* model = frame.model;
+    const int16_t_vec2* screen_coords = frame.screen_coords;
+    const uint8_t* outcodes = frame.outcodes;
+    uint_fix16_t* face_draw_order = frame.face_draw_order;
+
+    // Light per face, cached until model rotation or light changes
+    if (frame.render_mode == RENDER_MODES::TEXTURED_LIGHT)
+        frame.face_light = model->getFaceLight(directionalLightDir);
+
+    // Init the face_draw_order with visible faces
+    unsigned visible_faces = 0;
+    for (unsigned f_id=0; f_id<model->faces_count; f_id++)
+    {
+        unsigned int f_v0_id = model->faces[f_id].First;
+        unsigned int f_v1_id = model->faces[f_id].Second;
+        unsigned int f_v2_id = model->faces[f_id].Third;
+        const auto s0 = screen_coords[f_v0_id];
+        const auto s1 = screen_coords[f_v1_id];
+        const auto s2 = screen_coords[f_v2_id];
+        // Not visible, no need to sort it
+        const uint8_t c0 = outcodes[f_v0_id], c1 = outcodes[f_v1_id], c2 = outcodes[f_v2_id];
+        if (outcodesRejected(c0, c1, c2))
+            continue;
+        // Faces to clip are culled after clipping (screen coordinates are not valid)
+        if (model->cull_backfaces && !((c0 | c1 | c2) & OUTCODE_CLIP) && isBackFacing(s0, s1, s2)) {
+            frame.faces_culled++;
+            continue;
+        }
+
+        // Init index = f_id
+        face_draw_order[visible_faces].uint = f_id;
+        // Get face z-depth (only for sorting)
+        if (!z_buffer) {
+            Fix16 f_z_depth  = frame.vert_z_depths[f_v0_id]/3.0f;
+            f_z_depth       += frame.vert_z_depths[f_v1_id]/3.0f;
+            f_z_depth       += frame.vert_z_depths[f_v2_id]/3.0f;
+            face_draw_order[visible_faces].fix16 = f_z_depth;
+        }
+        visible_faces++;
+    }
+    frame.visible_faces = visible_faces;
+
+    // Sorting (depth buffer draws in any order)
+    if (!z_buffer)
+        radix_sort_depth(face_draw_order, frame.sort_scratch, visible_faces);
+}
+
+void Renderer::drawModelFrame(ModelFrame& frame, const fix16_clip_volume& clip_volume)
+{
+    Model* model = frame.model;
+    const int16_t_vec2* screen_coords = frame.screen_coords;
+    const uint16_t* inv_depths = frame.inv_depths;
+    const uint8_t* outcodes = frame.outcodes;
+    // Screen area drawn to, reported to dirty_rects below
+    int16_t_vec2& bbox_min = frame.bbox_min;
+    int16_t_vec2& bbox_max = frame.bbox_max;
+
+    RENDER_STATS_ADD(faces_culled, frame.faces_culled);
+
+    // Points and lines are drawn right away, over the triangles binned so far
+    if (frame.render_mode == RENDER_MODES::POINT_CLOUD || frame.render_mode == RENDER_MODES::LINES)
+        tile_binner.flush();
+
+    // Point-cloud
+    if (frame.render_mode == RENDER_MODES::POINT_CLOUD)
+    {
+        for (unsigned v_id=0; v_id<model->vertex_count; v_id++){
+            if(screen_coords[v_id].x == (int16_t) -999)
+                continue;
+            int16_t x = screen_coords[v_id].x;
+            int16_t y = screen_coords[v_id].y;
+            if (z_buffer)
+                draw_center_square_depth(x,y,5,5, inv_depths[v_id], color(0,0,0));
+            else
                 draw_center_square(x,y,5,5, color(0,0,0));
-                // Check bbox
-                if (bbox_max.x < x+2) bbox_max.x = x+2;
-                if (bbox_max.y < y+2) bbox_max.y = y+2;
-                if (bbox_min.x > x-2) bbox_min.x = x-2;
-                if (bbox_min.y > y-2) bbox_min.y = y-2;
-            }
         }
+    }
 
-        // Line-render
-        else if (RENDER_MODE == RENDER_MODES::LINES)
+    // Line-render
+    else if (frame.render_mode == RENDER_MODES::LINES)
+    {
+        for (unsigned int f_id=0; f_id<model->faces_count; f_id++)
         {
-            // Allocate memory
-            int16_t_vec2* screen_coords = (int16_t_vec2*) malloc(sizeof(int16_t_vec2) * it.first->vertex_count);
-
-            Fix16 fix16_sink;
-            // Get screen coordinates
-            for (unsigned v_id=0; v_id<it.first->vertex_count; v_id++){
-                fix16_vec2 screen_vec2;
-                screen_vec2 = getScreenCoordinate(
-                    FOV, it.first->vertices[v_id],
-                    it.first->getPosition_ref(), it.first->getRotation_ref(),
-                    it.first->getScale_ref(),
-                    camera_pos, camera_rot,
-                    &fix16_sink, &is_valid
-                );
-                int16_t x = (int16_t)screen_vec2.x;
-                int16_t y = (int16_t)screen_vec2.y;
-                screen_coords[v_id] = {x, y};
-                // Check bbox
-                if(is_valid == false)
+            const unsigned ids[3] = {
+                model->faces[f_id].First, model->faces[f_id].Second, model->faces[f_id].Third
+            };
+            if (outcodesRejected(outcodes[ids[0]], outcodes[ids[1]], outcodes[ids[2]]))
+                continue;
+            for (unsigned e = 0; e < 3; e++) {
+                const unsigned a = ids[e];
+                const unsigned b = ids[e == 2 ? 0 : e + 1];
+                // Both ends off the same screen side
+                if (outcodes[a] & outcodes[b] & (OUTCODE_LEFT | OUTCODE_RIGHT | OUTCODE_TOP | OUTCODE_BOTTOM | OUTCODE_NEAR))
                     continue;
-                if (bbox_max.x < x) bbox_max.x = x;
-                if (bbox_max.y < y) bbox_max.y = y;
-                if (bbox_min.x > x) bbox_min.x = x;
-                if (bbox_min.y > y) bbox_min.y = y;
-            }
-
-            for (unsigned int f_id=0; f_id<it.first->faces_count; f_id++)
-            {
-                const auto v0 = screen_coords[it.first->faces[f_id].First];
-                const auto v1 = screen_coords[it.first->faces[f_id].Second];
-                const auto v2 = screen_coords[it.first->faces[f_id].Third];
-                if( v0.x == (int16_t) -999 ||
-                    v1.x == (int16_t) -999 ||
-                    v2.x == (int16_t) -999
-                ){
+                if ((outcodes[a] | outcodes[b]) & OUTCODE_CLIP) {
+                    drawClippedLine(model, frame.model_view, clip_volume, a, b, bbox_min, bbox_max);
                     continue;
                 }
-                line(v0.x,v0.y, v1.x, v1.y, it.first->color);
-                line(v1.x,v1.y, v2.x, v2.y, it.first->color);
-                line(v2.x,v2.y, v0.x, v0.y, it.first->color);
+                const auto va = screen_coords[a];
+                const auto vb = screen_coords[b];
+                if (z_buffer)
+                    lineDepth(va.x,va.y,inv_depths[a], vb.x,vb.y,inv_depths[b], model->color);
+                else
+                    line(va.x,va.y, vb.x,vb.y, model->color);
             }
-            free(screen_coords);
         }
+    }
 
-        // Textured faces without light
-        else if (RENDER_MODE == RENDER_MODES::TEXTURED)
+    // Textured faces, lit with face_light in TEXTURED_LIGHT
+    else
+    {
+        for (unsigned int ordered_id=0; ordered_id<frame.visible_faces; ordered_id++)
         {
-            // Check first if model has texture
-            if (!it.first->has_texture){
-                it.first->render_mode++;
+            auto f_id = frame.face_draw_order[ordered_id].uint;
+            const Fix16 light = frame.face_light ? frame.face_light[f_id] : Fix16(1.0f);
+            const uint8_t codes =
+                outcodes[model->faces[f_id].First] |
+                outcodes[model->faces[f_id].Second] |
+                outcodes[model->faces[f_id].Third];
+            if (codes & OUTCODE_CLIP) {
+                drawClippedFace(model, f_id, frame.model_view, clip_volume, light, bbox_min, bbox_max);
                 continue;
             }
-
-            // Allocate memory
-            int16_t_vec2* screen_coords = (int16_t_vec2*) malloc(sizeof(int16_t_vec2) * it.first->vertex_count);
-            Fix16 * vert_z_depths = (Fix16*) malloc(sizeof(Fix16) * it.first->vertex_count);
-            uint_fix16_t * face_draw_order = (uint_fix16_t*) malloc(sizeof(uint_fix16_t) * it.first->faces_count);
-
-            // Get screen coordinates
-            for (unsigned v_id=0; v_id<it.first->vertex_count; v_id++){
-                fix16_vec2 screen_vec2;
-                screen_vec2 = getScreenCoordinate(
-                    FOV, it.first->vertices[v_id],
-                    it.first->getPosition_ref(), it.first->getRotation_ref(),
-                    it.first->getScale_ref(),
-                    camera_pos, camera_rot,
-                    &vert_z_depths[v_id], &is_valid
+            const auto v0 = screen_coords[model->faces[f_id].First];
+            const auto v1 = screen_coords[model->faces[f_id].Second];
+            const auto v2 = screen_coords[model->faces[f_id].Third];
+            auto uv0_fix16_norm = model->uv_coords[model->uv_faces[f_id].First];
+            auto uv1_fix16_norm = model->uv_coords[model->uv_faces[f_id].Second];
+            auto uv2_fix16_norm = model->uv_coords[model->uv_faces[f_id].Third];
+
+            auto v0_u = (int16_t) (uv0_fix16_norm.x * (Fix16((int16_t)model->gen_textureWidth)));
+            auto v0_v = (int16_t) (uv0_fix16_norm.y * (Fix16((int16_t)model->gen_textureHeight)));
+
+            auto v1_u = (int16_t) (uv1_fix16_norm.x * (Fix16((int16_t)model->gen_textureWidth)));
+            auto v1_v = (int16_t) (uv1_fix16_norm.y * (Fix16((int16_t)model->gen_textureHeight)));
+
+            auto v2_u = (int16_t) (uv2_fix16_norm.x * (Fix16((int16_t)model->gen_textureWidth)));
+            auto v2_v = (int16_t) (uv2_fix16_norm.y * (Fix16((int16_t)model->gen_textureHeight)));
+
+            // Smaller texture for far away triangles
+            const unsigned mip = model->selectMipLevel(
+                triangleArea2(v0_u, v0_v, v1_u, v1_v, v2_u, v2_v),
+                triangleArea2(v0.x, v0.y, v1.x, v1.y, v2.x, v2.y)
+            );
+            const MipLevel& texture = model->mip_levels[mip];
+
+            int16_t_Point2d v0_screen = {v0.x,v0.y, (int16_t) (v0_u >> mip), (int16_t) (v0_v >> mip)};
+            int16_t_Point2d v1_screen = {v1.x,v1.y, (int16_t) (v1_u >> mip), (int16_t) (v1_v >> mip)};
+            int16_t_Point2d v2_screen = {v2.x,v2.y, (int16_t) (v2_u >> mip), (int16_t) (v2_v >> mip)};
+
+            if (z_buffer) {
+                tile_binner.addTriangleDepth(
+                    v0_screen, v1_screen, v2_screen,
+                    inv_depths[model->faces[f_id].First],
+                    inv_depths[model->faces[f_id].Second],
+                    inv_depths[model->faces[f_id].Third],
+                    texture,
+                    light
                 );
-                int16_t x = (int16_t)screen_vec2.x;
-                int16_t y = (int16_t)screen_vec2.y;
-                screen_coords[v_id] = {x, y};
-                // Check bbox
-                if(is_valid == false)
-                    continue;
-                if (bbox_max.x < x) bbox_max.x = x;
-                if (bbox_max.y < y) bbox_max.y = y;
-                if (bbox_min.x > x) bbox_min.x = x;
-                if (bbox_min.y > y) bbox_min.y = y;
-            }
-
-            // Init the face_draw_order
-            for (unsigned f_id=0; f_id<it.first->faces_count; f_id++)
-            {
-                unsigned int f_v0_id = it.first->faces[f_id].First;
-                unsigned int f_v1_id = it.first->faces[f_id].Second;
-                unsigned int f_v2_id = it.first->faces[f_id].Third;
-                // Get face z-depth
-                Fix16 f_z_depth  = vert_z_depths[f_v0_id]/3.0f;
-                f_z_depth       += vert_z_depths[f_v1_id]/3.0f;
-                f_z_depth       += vert_z_depths[f_v2_id]/3.0f;
-
-                // Init index = f_id
-                face_draw_order[f_id].uint = f_id;
-                face_draw_order[f_id].fix16 = f_z_depth;
+                continue;
             }
-            // Sorting
-            bubble_sort(face_draw_order, it.first->faces_count);
-
-            // Draw face edges
-            for (unsigned int ordered_id=0; ordered_id<it.first->faces_count; ordered_id++)
-            {
-                auto f_id = face_draw_order[ordered_id].uint;
-                const auto v0 = screen_coords[it.first->faces[f_id].First];
-                const auto v1 = screen_coords[it.first->faces[f_id].Second];
-                const auto v2 = screen_coords[it.first->faces[f_id].Third];
-                if( v0.x == (int16_t) -999 ||
-                    v1.x == (int16_t) -999 ||
-                    v2.x == (int16_t) -999
-                ){
-                    continue;
-                }
-                auto uv0_fix16_norm = it.first->uv_coords[it.first->uv_faces[f_id].First];
-                auto uv1_fix16_norm = it.first->uv_coords[it.first->uv_faces[f_id].Second];
-                auto uv2_fix16_norm = it.first->uv_coords[it.first->uv_faces[f_id].Third];
-
-                auto v0_u = (int16_t) (uv0_fix16_norm.x * (Fix16((int16_t)it.first->gen_textureWidth)));
-                auto v0_v = (int16_t) (uv0_fix16_norm.y * (Fix16((int16_t)it.first->gen_textureHeight)));
-
-                auto v1_u = (int16_t) (uv1_fix16_norm.x * (Fix16((int16_t)it.first->gen_textureWidth)));
-                auto v1_v = (int16_t) (uv1_fix16_norm.y * (Fix16((int16_t)it.first->gen_textureHeight)));
+            tile_binner.addTriangle(
+                v0_screen, v1_screen, v2_screen,
+                texture,
+                light
+            );
+        }
+    }
 
-                auto v2_u = (int16_t) (uv2_fix16_norm.x * (Fix16((int16_t)it.first->gen_textureWidth)));
-                auto v2_v = (int16_t) (uv2_fix16_norm.y * (Fix16((int16_t)it.first->gen_textureHeight)));
+    // Some buffer around bbox (as draw lines may draw over the bbox)
+    if (bbox_min.x <= bbox_max.x)
+        dirty_rects.add(bbox_min.x - 2, bbox_min.y - 2, bbox_max.x + 2, bbox_max.y + 2);
+}
 
-                int16_t_Point2d v0_screen = {v0.x,v0.y, v0_u, v0_v};
-                int16_t_Point2d v1_screen = {v1.x,v1.y, v1_u, v1_v};
-                int16_t_Point2d v2_screen = {v2.x,v2.y, v2_u, v2_v};
+void Renderer::updateModels(
+    const fix16_mat3x4& camera_matrix, const fix16_frustum& frustum, const fix16_clip_volume& clip_volume
+) {
+    for (auto& it : modelArray) {
+        Model* model = it.first;
+        if (!modelVisible(model, camera_matrix, frustum))
+            continue;
 
-                drawTriangle(
-                    v0_screen, v1_screen, v2_screen,
-                    //gen_uv_tex, gen_textureWidth, gen_textureHeight
-                    it.first->gen_uv_tex,
-                    it.first->gen_textureWidth,
-                    it.first->gen_textureHeight
-                );
-            }
-            free(face_draw_order);
-            free(vert_z_depths);
-            free(screen_coords);
+        const uint32_t arena_mark = frame_arena.mark();
+        ModelFrame frame;
+        beginModelFrame(frame, model, camera_matrix);
+        {
+            PROFILE_ZONE(PROF_TRANSFORM);
+            transformVertices(frame, 0, model->vertex_count, frame.bbox_min, frame.bbox_max);
+        }
+        if (frame.render_mode >= RENDER_MODES::TEXTURED) {
+            PROFILE_ZONE(PROF_SORT);
+            orderFaces(frame);
         }
-
-        // Texture + light
-        if (RENDER_MODE == RENDER_MODES::TEXTURED_LIGHT)
         {
-            // Check first if model has texture
-            if (!it.first->has_texture){
-                it.first->render_mode = 0;
-                continue;
-            }
+            PROFILE_ZONE(PROF_DRAW);
+            drawModelFrame(frame, clip_volume);
+        }
+        frame_arena.rewind(arena_mark);
+    }
+}
 
-            // Allocate memory
-            int16_t_vec2* screen_coords = (int16_t_vec2*) malloc(sizeof(int16_t_vec2) * it.first->vertex_count);
-            Fix16 * vert_z_depths = (Fix16*) malloc(sizeof(Fix16) * it.first->vertex_count);
-            uint_fix16_t * face_draw_order = (uint_fix16_t*) malloc(sizeof(uint_fix16_t) * it.first->faces_count);
-            fix16_vec3* face_normals = (fix16_vec3*) malloc(sizeof(fix16_vec3) * it.first->faces_count);
-
-            // Get screen coordinates
-            for (unsigned v_id=0; v_id<it.first->vertex_count; v_id++){
-                fix16_vec2 screen_vec2;
-                screen_vec2 = getScreenCoordinate(
-                    FOV, it.first->vertices[v_id],
-                    it.first->getPosition_ref(), it.first->getRotation_ref(),
-                    it.first->getScale_ref(),
-                    camera_pos, camera_rot,
-                    &vert_z_depths[v_id], &is_valid
-                );
-                int16_t x = (int16_t)screen_vec2.x;
-                int16_t y = (int16_t)screen_vec2.y;
-                screen_coords[v_id] = {x, y};
-                // Check bbox
-                if(is_valid == false)
-                    continue;
-                if (bbox_max.x < x) bbox_max.x = x;
-                if (bbox_max.y < y) bbox_max.y = y;
-                if (bbox_min.x > x) bbox_min.x = x;
-                if (bbox_min.y > y) bbox_min.y = y;
-            }
+#ifdef PC
+void Renderer::updateModelsJobs(
+    const fix16_mat3x4& camera_matrix, const fix16_frustum& frustum, const fix16_clip_volume& clip_volume
+) {
+    // Visible models in draw order
+    model_frames.clear();
+    uint32_t bytes = frame_arena.mark();
+    for (auto& it : modelArray) {
+        Model* model = it.first;
+        if (!modelVisible(model, camera_matrix, frustum))
+            continue;
+        ModelFrame frame = {};
+        frame.model = model;
+        model_frames.push_back(frame);
+        bytes += modelFrameBytes(model, model->render_mode, z_buffer);
+    }
+    const unsigned frame_count = model_frames.getSize();
+
+    // Scratch of all models at once. Only fails without memory, draw one
+    // model at a time then.
+    if (!frame_arena.reserve(bytes)) {
+        for (unsigned i = 0; i < frame_count; i++) {
+            const uint32_t arena_mark = frame_arena.mark();
+            ModelFrame& frame = model_frames[i];
+            beginModelFrame(frame, frame.model, camera_matrix);
+            transformVertices(frame, 0, frame.model->vertex_count, frame.bbox_min, frame.bbox_max);
+            orderFaces(frame);
+            drawModelFrame(frame, clip_volume);
+            frame_arena.rewind(arena_mark);
+        }
+        return;
+    }
 
-            // Init the face_draw_order
-            for (unsigned f_id=0; f_id<it.first->faces_count; f_id++)
-            {
-                unsigned int f_v0_id = it.first->faces[f_id].First;
-                unsigned int f_v1_id = it.first->faces[f_id].Second;
-                unsigned int f_v2_id = it.first->faces[f_id].Third;
-
-                // Get face z-depth
-                Fix16 f_z_depth  = vert_z_depths[f_v0_id]/3.0f;
-                f_z_depth       += vert_z_depths[f_v1_id]/3.0f;
-                f_z_depth       += vert_z_depths[f_v2_id]/3.0f;
-
-                // Init index = f_id
-                face_draw_order[f_id].uint = f_id;
-                face_draw_order[f_id].fix16 = f_z_depth;
-                // ----- Calculate also face normals here
-
-                // Face vertices
-                fix16_vec3 v0 = it.first->vertices[f_v0_id];
-                fix16_vec3 v1 = it.first->vertices[f_v1_id];
-                fix16_vec3 v2 = it.first->vertices[f_v2_id];
-                // Model rotation
-                rotateOnPlane(v0.x, v0.z, it.first->rotation.x);
-                rotateOnPlane(v0.y, v0.z, it.first->rotation.y);
-                rotateOnPlane(v1.x, v1.z, it.first->rotation.x);
-                rotateOnPlane(v1.y, v1.z, it.first->rotation.y);
-                rotateOnPlane(v2.x, v2.z, it.first->rotation.x);
-                rotateOnPlane(v2.y, v2.z, it.first->rotation.y);
-                // Model translation
-                v0.x += it.first->position.x;
-                v0.y += it.first->position.y;
-                v0.z += it.first->position.z;
-                v1.x += it.first->position.x;
-                v1.y += it.first->position.y;
-                v1.z += it.first->position.z;
-                v2.x += it.first->position.x;
-                v2.y += it.first->position.y;
-                v2.z += it.first->position.z;
-                // Calculate face normal
-                auto face_norm = calculateNormal(v0, v1, v2);
-                normalize_fix16_vec3(face_norm);
-                //
-                face_normals[f_id] = face_norm;
-            }
+    // Transform jobs of at most JOB_VERTEX_RANGE vertices
+    vertex_jobs.clear();
+    for (unsigned i = 0; i < frame_count; i++) {
+        ModelFrame& frame = model_frames[i];
+        beginModelFrame(frame, frame.model, camera_matrix);
+        const unsigned vertex_count = frame.model->vertex_count;
+        for (unsigned begin = 0; begin < vertex_count; begin += JOB_VERTEX_RANGE) {
+            const unsigned end = vertex_count - begin > JOB_VERTEX_RANGE ? begin + JOB_VERTEX_RANGE : vertex_count;
+            vertex_jobs.push_back({i, begin, end, {SCREEN_X, SCREEN_Y}, {0, 0}});
+        }
+    }
 
-            // Sorting
-            bubble_sort(face_draw_order, it.first->faces_count);
-
-            // Draw face edges
-            for (unsigned int ordered_id=0; ordered_id<it.first->faces_count; ordered_id++)
-            {
-                auto f_id = face_draw_order[ordered_id].uint;
-                const auto v0 = screen_coords[it.first->faces[f_id].First];
-                const auto v1 = screen_coords[it.first->faces[f_id].Second];
-                const auto v2 = screen_coords[it.first->faces[f_id].Third];
-                if( v0.x == (int16_t) -999 ||
-                    v1.x == (int16_t) -999 ||
-                    v2.x == (int16_t) -999
-                ){
-                    continue;
-                }
-                auto uv0_fix16_norm = it.first->uv_coords[it.first->uv_faces[f_id].First];
-                auto uv1_fix16_norm = it.first->uv_coords[it.first->uv_faces[f_id].Second];
-                auto uv2_fix16_norm = it.first->uv_coords[it.first->uv_faces[f_id].Third];
+    {
+        PROFILE_ZONE(PROF_TRANSFORM);
+        auto transform = [this](unsigned j) {
+            VertexJob& job = vertex_jobs[j];
+            transformVertices(model_frames[job.frame], job.begin, job.end, job.bbox_min, job.bbox_max);
+        };
+        job_system.run(vertex_jobs.getSize(), transform);
+        for (unsigned j = 0; j < vertex_jobs.getSize(); j++) {
+            const VertexJob& job = vertex_jobs[j];
+            ModelFrame& frame = model_frames[job.frame];
+            if (frame.bbox_min.x > job.bbox_min.x) frame.bbox_min.x = job.bbox_min.x;
+            if (frame.bbox_min.y > job.bbox_min.y) frame.bbox_min.y = job.bbox_min.y;
+            if (frame.bbox_max.x < job.bbox_max.x) frame.bbox_max.x = job.bbox_max.x;
+            if (frame.bbox_max.y < job.bbox_max.y) frame.bbox_max.y = job.bbox_max.y;
+        }
+    }
 
-                auto v0_u = (int16_t) (uv0_fix16_norm.x * (Fix16((int16_t)it.first->gen_textureWidth)));
-                auto v0_v = (int16_t) (uv0_fix16_norm.y * (Fix16((int16_t)it.first->gen_textureHeight)));
+    {
+        PROFILE_ZONE(PROF_SORT);
+        auto order = [this](unsigned i) { orderFaces(model_frames[i]); };
+        job_system.run(frame_count, order);
+    }
 
-                auto v1_u = (int16_t) (uv1_fix16_norm.x * (Fix16((int16_t)it.first->gen_textureWidth)));
-                auto v1_v = (int16_t) (uv1_fix16_norm.y * (Fix16((int16_t)it.first->gen_textureHeight)));
+    PROFILE_ZONE(PROF_DRAW);
+    for (unsigned i = 0; i < frame_count; i++)
+        drawModelFrame(model_frames[i], clip_volume);
+}
+#endif
 
-                auto v2_u = (int16_t) (uv2_fix16_norm.x * (Fix16((int16_t)it.first->gen_textureWidth)));
-                auto v2_v = (int16_t) (uv2_fix16_norm.y * (Fix16((int16_t)it.first->gen_textureHeight)));
+void Renderer::update()
+{
+    // Depth buffer is allocated when first needed. Keep sorting if it does not fit.
+    if (z_buffer && !zbuffer) {
+        zbuffer = (uint16_t*) malloc(SCREEN_X * SCREEN_Y * sizeof(uint16_t));
+        if (zbuffer)
+            memset(zbuffer, 0, SCREEN_X * SCREEN_Y * sizeof(uint16_t));
+        else
+            z_buffer = false;
+    }
 
-                int16_t_Point2d v0_screen = {v0.x,v0.y, v0_u, v0_v};
-                int16_t_Point2d v1_screen = {v1.x,v1.y, v1_u, v1_v};
-                int16_t_Point2d v2_screen = {v2.x,v2.y, v2_u, v2_v};
+    // Depth buffer does not need any model order
+    if (camera_move_dirty && !z_buffer)
+    {
+        PROFILE_ZONE(PROF_MODEL_SORT);
+        camera_move_dirty = false;
+        // Sort all models in order from camera. A cheap way to have alteast
+        // some kind of order between models. Correct way would be to do this
+        // per triangle but calculating square root per triangle takes long time
+        // -> Accepting tradeoff of accuracy to gain speed.
 
-                Fix16 lightIntensity = calculateLightIntensityDirLight(
-                        directionalLightDir, face_normals[f_id], Fix16(1.0f)
-                );
-                drawTriangle(
-                    v0_screen, v1_screen, v2_screen,
-                    it.first->gen_uv_tex,
-                    it.first->gen_textureWidth,
-                    it.first->gen_textureHeight,
-                    lightIntensity
-                );
-            }
-            free(face_draw_order);
-            free(vert_z_depths);
-            free(screen_coords);
-            free(face_normals);
+        // TODO: MAKE THIS DISTANCE ALSO TAKE INTO ACCOUNT IS IT VISIBLE OR NOT!!
+        //
+        unsigned i = 0;
+        for (auto& it : modelArray) {
+            Model* m = it.first;
+            Fix16 dist = calculateDistance(m->getPosition_ref(), camera_pos);
+            it.second = dist;
+            i++;
         }
 
-        #ifdef PER_MODEL_CLEAR
-        //Some buffer around bbox (as draw lines may draw over the bbox)
-        bbox_min.x -= 2;
-        bbox_min.y -= 2;
-        bbox_max.x += 2;
-        bbox_max.y += 2;
-        // Check bbox - clamp
-        if(bbox_min.x < 0)        bbox_min.x = 0;
-        if(bbox_min.y < 0)        bbox_min.y = 0;
-        if(bbox_max.x > SCREEN_X) bbox_max.x = SCREEN_X;
-        if(bbox_max.y > SCREEN_Y) bbox_max.y = SCREEN_Y;
-        #endif
+        // Sort by camera distance (in reverse order).
+        //sort_modelRenderOrder(modelArray.getRawArray(), modelArray.getSize());
+        modelArray.sort(modelArrayCompare);
     }
 
-#ifndef PER_MODEL_CLEAR
-    // Some buffer around bbox (as draw lines may draw over the bbox)
-    bbox_min.x -= 2;
-    bbox_min.y -= 2;
-    bbox_max.x += 2;
-    bbox_max.y += 2;
-
-    // Check bbox - clamp
-    if(bbox_min.x < 0)        bbox_min.x = 0;
-    if(bbox_min.y < 0)        bbox_min.y = 0;
-    if(bbox_max.x > SCREEN_X) bbox_max.x = SCREEN_X;
-    if(bbox_max.y > SCREEN_Y) bbox_max.y = SCREEN_Y;
+    const fix16_mat3x4 camera_matrix = getCameraMatrix(camera_pos, camera_rot);
+    const fix16_frustum frustum = getViewFrustum(FOV, far_distance);
+    const fix16_clip_volume clip_volume = getClipVolume(FOV);
+
+#ifdef PC
+    if (job_system.get_threads() > 1)
+        updateModelsJobs(camera_matrix, frustum, clip_volume);
+    else
 #endif
+        updateModels(camera_matrix, frustum, clip_volume);
+
+    {
+        PROFILE_ZONE(PROF_DRAW);
+        tile_binner.flush();
+    }
+
+    PROFILE_ZONE(PROF_UI);
+
     // Draw rotation visualizer in corner
     draw_RotationVisualizer(camera_rot);
 
     // Draw minimap
-    draw_Minimap(false);
+    draw_Minimap();
 }
 
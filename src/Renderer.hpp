@@ -7,7 +7,17 @@
 
 #include "Pair.hpp"
 
+#include "FrameArena.hpp"
+
+#include "DirtyRects.hpp"
+
+#include "TileBinner.hpp"
+
 #ifdef PC
+#   include "JobSystem.hpp"
+#endif
+
+#if defined(PC) && !defined(HEADLESS)
 #   include <SDL2/SDL.h>
 #endif
 
@@ -27,6 +37,39 @@ enum RENDER_MODES {
     TEXTURED_LIGHT  = 3
 };
 
+// Vertices per transform job, larger meshes are split (PC)
+#define JOB_VERTEX_RANGE 256
+
+// Results of the transform and face order stages of Renderer::update() for
+// one visible model. Scratch from the frame arena, nullptr when the render
+// mode does not need it.
+struct ModelFrame {
+    Model*        model;
+    uint16_t      render_mode;
+    fix16_mat3x4  model_view;
+    int16_t_vec2* screen_coords;
+    Fix16*        vert_z_depths;   // Textured
+    uint16_t*     inv_depths;      // Depth buffer
+    uint8_t*      outcodes;        // Not for point clouds
+    uint_fix16_t* face_draw_order; // Textured: visible faces in draw order
+    uint_fix16_t* sort_scratch;    // Textured without depth buffer
+    const Fix16*  face_light;      // TEXTURED_LIGHT
+    unsigned      visible_faces;
+    uint32_t      faces_culled;
+    // Screen area drawn to
+    int16_t_vec2  bbox_min;
+    int16_t_vec2  bbox_max;
+};
+
+// Vertices [begin, end) of one model frame, a transform job (PC)
+struct VertexJob {
+    unsigned     frame;
+    unsigned     begin;
+    unsigned     end;
+    int16_t_vec2 bbox_min;
+    int16_t_vec2 bbox_max;
+};
+
 class Renderer
 {
 private:
@@ -36,15 +79,55 @@ private:
     fix16_vec3 camera_pos;
     fix16_vec2 camera_rot;
     Fix16 FOV;
+    Fix16 far_distance;
+    // Depth buffer (see zbuffer) instead of sorting models and faces
+    bool z_buffer;
 
     fix16_vec3 lightPos;
     fix16_vec3 directionalLightDir;
 
     int16_t_vec2 minimapPos;
 
-#ifndef PER_MODEL_CLEAR
-    int16_t_vec2 bbox_max;
-    int16_t_vec2 bbox_min;
+    // Per-model scratch buffers of update(), sized for the largest model.
+    // Reset in screen_flush().
+    FrameArena frame_arena;
+
+    // Textured triangles of update(), rasterized tile by tile when flushed
+    TileBinner tile_binner;
+
+    // Slow paths of update() for geometry with OUTCODE_CLIP vertices: clipped
+    // in camera space against the near plane and guard band, then drawn.
+    // The drawn part grows the bounding box, faces go to tile_binner.
+    void drawClippedFace(
+        Model* model, unsigned f_id, const fix16_mat3x4& model_view, const fix16_clip_volume& clip,
+        Fix16 light, int16_t_vec2& bbox_min, int16_t_vec2& bbox_max
+    );
+    void drawClippedLine(
+        Model* model, const fix16_mat3x4& model_view, const fix16_clip_volume& clip,
+        unsigned v_a, unsigned v_b, int16_t_vec2& bbox_min, int16_t_vec2& bbox_max
+    );
+
+    // Stages of update() per visible model (see Renderer.cpp)
+    bool modelVisible(Model* model, const fix16_mat3x4& camera_matrix, const fix16_frustum& frustum);
+    static uint32_t modelFrameBytes(const Model* model, uint16_t render_mode, bool depth);
+    void beginModelFrame(ModelFrame& frame, Model* model, const fix16_mat3x4& camera_matrix);
+    void transformVertices(
+        const ModelFrame& frame, unsigned begin, unsigned end, int16_t_vec2& bbox_min, int16_t_vec2& bbox_max
+    ) const;
+    void orderFaces(ModelFrame& frame) const;
+    void drawModelFrame(ModelFrame& frame, const fix16_clip_volume& clip_volume);
+
+    // One model after the other
+    void updateModels(
+        const fix16_mat3x4& camera_matrix, const fix16_frustum& frustum, const fix16_clip_volume& clip_volume
+    );
+#ifdef PC
+    // Transform and face order of all models as jobs, then drawn in order
+    void updateModelsJobs(
+        const fix16_mat3x4& camera_matrix, const fix16_frustum& frustum, const fix16_clip_volume& clip_volume
+    );
+    DynamicArray<ModelFrame> model_frames;
+    DynamicArray<VertexJob>  vertex_jobs;
 #endif
 
 public:
@@ -61,18 +144,25 @@ public:
     fix16_vec3& get_camera_pos();
     fix16_vec2& get_camera_rot();
     Fix16     & get_FOV();
+    Fix16     & get_farDistance();
+    bool      & get_zBuffer();
     fix16_vec3& get_lightPos();
     int16_t_vec2& get_minimapPos();
+    FrameArena& get_frameArena();
+    TileBinner& get_tileBinner();
 
     void screen_flush();
 
-    void draw_Minimap(bool clear);
+    void draw_Minimap();
 
-#ifdef PC
+#if defined(PC) && !defined(HEADLESS)
     int custom_sdl2_init(SDL_Window **window, SDL_Renderer **sdl_renderer, SDL_Texture ** texture);
     SDL_Window * _window;
     SDL_Renderer * _sdl_renderer;
     SDL_Texture * _texture;
+    // Screen areas that differ from _texture
+    DirtyRects present_rects;
+    void present_dirty();
 #endif
 
     Renderer();
@@ -7,10 +7,13 @@
 #   include <sdk/os/debug.h>
 #   include <stdio.h> // For FILE, fopen, etc.
 #else
-#   include <SDL2/SDL.h>
+#   ifndef HEADLESS
+#       include <SDL2/SDL.h>
+#   endif
 #   include <iostream>
 #   include <unistd.h>  // File open & close
 #   include <fcntl.h>   // File open & close
+#   include <string.h>  // memset
 #endif
 
 // Does not require NULL termination
@@ -0,0 +1,106 @@
+#include "TileBinner.hpp"
+
+#include "RenderStats.hpp"
+
+void TileBinner::addTriangle(
+    const int16_t_Point2d& v0, const int16_t_Point2d& v1, const int16_t_Point2d& v2,
+    const MipLevel& texture,
+    Fix16 lightInstensity
+) {
+    RasterTriangle t;
+    if (setupTriangle(v0, v1, v2, 0, 0, 0, texture, lightInstensity, false, t))
+        triangles.push_back(t);
+}
+
+void TileBinner::addTriangleDepth(
+    const int16_t_Point2d& v0, const int16_t_Point2d& v1, const int16_t_Point2d& v2,
+    uint16_t z0, uint16_t z1, uint16_t z2,
+    const MipLevel& texture,
+    Fix16 lightInstensity
+) {
+    RasterTriangle t;
+    if (setupTriangle(v0, v1, v2, z0, z1, z2, texture, lightInstensity, true, t))
+        triangles.push_back(t);
+}
+
+// ~~~~~~~~~~~~~~~~ Binning ~~~~~~~~~~~~~~~~
+
+bool TileBinner::bin()
+{
+    const unsigned count = triangles.getSize();
+
+    // Triangles per tile, one entry late: turns into the start after the sums
+    for (unsigned i = 0; i <= RASTER_TILE_COUNT; i++)
+        tile_start[i] = 0;
+    for (unsigned i = 0; i < count; i++) {
+        const RasterTriangle& t = triangles[i];
+        const int tx0 = t.x0 >> RASTER_TILE_SIZE_LOG2, tx1 = (t.x1 - 1) >> RASTER_TILE_SIZE_LOG2;
+        const int ty0 = t.y0 >> RASTER_TILE_SIZE_LOG2, ty1 = (t.y1 - 1) >> RASTER_TILE_SIZE_LOG2;
+        for (int ty = ty0; ty <= ty1; ty++)
+            for (int tx = tx0; tx <= tx1; tx++)
+                tile_start[ty * RASTER_TILES_X + tx + 1]++;
+    }
+    for (unsigned i = 0; i < RASTER_TILE_COUNT; i++)
+        tile_start[i + 1] += tile_start[i];
+    if (!tile_triangles.reserve(tile_start[RASTER_TILE_COUNT]))
+        return false;
+
+    // Indices in draw order, tile_start[i + 1] is where tile i continues until
+    // it reaches the start of tile i + 1
+    uint32_t* indices = tile_triangles.getRawArray();
+    for (unsigned i = 0; i < count; i++) {
+        const RasterTriangle& t = triangles[i];
+        const int tx0 = t.x0 >> RASTER_TILE_SIZE_LOG2, tx1 = (t.x1 - 1) >> RASTER_TILE_SIZE_LOG2;
+        const int ty0 = t.y0 >> RASTER_TILE_SIZE_LOG2, ty1 = (t.y1 - 1) >> RASTER_TILE_SIZE_LOG2;
+        for (int ty = ty0; ty <= ty1; ty++)
+            for (int tx = tx0; tx <= tx1; tx++)
+                indices[tile_start[ty * RASTER_TILES_X + tx]++] = i;
+    }
+    // Every start moved up by its tile's count, one entry back is the real start
+    for (unsigned i = RASTER_TILE_COUNT; i > 0; i--)
+        tile_start[i] = tile_start[i - 1];
+    tile_start[0] = 0;
+    return true;
+}
+
+uint32_t TileBinner::rasterizeTile(unsigned tile)
+{
+    const int x0 = (tile % RASTER_TILES_X) << RASTER_TILE_SIZE_LOG2;
+    const int y0 = (tile / RASTER_TILES_X) << RASTER_TILE_SIZE_LOG2;
+    const int x1 = x0 + RASTER_TILE_SIZE > SCREEN_X ? SCREEN_X : x0 + RASTER_TILE_SIZE;
+    const int y1 = y0 + RASTER_TILE_SIZE > SCREEN_Y ? SCREEN_Y : y0 + RASTER_TILE_SIZE;
+
+    const uint32_t* indices = tile_triangles.getRawArray();
+    uint32_t written = 0;
+    for (uint32_t i = tile_start[tile]; i < tile_start[tile + 1]; i++)
+        written += rasterizeTriangle(triangles[indices[i]], x0, y0, x1, y1);
+    return written;
+}
+
+void TileBinner::flush()
+{
+    const unsigned count = triangles.getSize();
+    if (count == 0)
+        return;
+
+    uint32_t written = 0;
+    if (!bin()) {
+        // No memory for the tile lists: whole screen, one triangle after the other
+        for (unsigned i = 0; i < count; i++)
+            written += rasterizeTriangle(triangles[i], 0, 0, SCREEN_X, SCREEN_Y);
+    }
+#ifdef PC
+    else if (job_system.get_threads() > 1 && count >= RASTER_THREAD_MIN_TRIANGLES) {
+        auto scan_tile = [this](unsigned tile) { tile_written[tile] = rasterizeTile(tile); };
+        job_system.run(RASTER_TILE_COUNT, scan_tile);
+        for (unsigned tile = 0; tile < RASTER_TILE_COUNT; tile++)
+            written += tile_written[tile];
+    }
+#endif
+    else {
+        for (unsigned tile = 0; tile < RASTER_TILE_COUNT; tile++)
+            written += rasterizeTile(tile);
+    }
+    RENDER_STATS_ADD(pixels_written, written);
+    triangles.clear();
+}
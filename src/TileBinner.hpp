@@ -0,0 +1,74 @@
+#pragma once
+
+// Tile binned rasterization of textured triangles.
+//
+// Renderer::update() sets triangles up in draw order (addTriangle) instead of
+// scanning them right away. flush() sorts them into square screen tiles of
+// RASTER_TILE_SIZE pixels, draw order kept within each tile, and scans one
+// tile after the other clipped to it: the tile's screen and depth rows stay
+// in cache for every triangle covering it. Tiles never share pixels, so
+// painter's order only matters inside a tile and the image is the same as
+// drawing the triangles one by one.
+//
+// PC runs the tiles as jobs on all threads of job_system, the calculator runs
+// the same tile loop on one thread.
+//
+// Anything drawn without the binner (lines, points, UI) has to flush() first
+// to end up over the triangles added before it.
+
+#include "RenderUtils.hpp"
+
+#include "DynamicArray.hpp"
+
+#include <stdint.h>
+
+#ifdef PC
+#   include "JobSystem.hpp"
+#endif
+
+#define RASTER_TILE_SIZE  (1 << RASTER_TILE_SIZE_LOG2)
+#define RASTER_TILES_X    ((SCREEN_X + RASTER_TILE_SIZE - 1) >> RASTER_TILE_SIZE_LOG2)
+#define RASTER_TILES_Y    ((SCREEN_Y + RASTER_TILE_SIZE - 1) >> RASTER_TILE_SIZE_LOG2)
+#define RASTER_TILE_COUNT (RASTER_TILES_X * RASTER_TILES_Y)
+
+// Fewer triangles are scanned by the flushing thread alone, waking the
+// job_system workers costs more than it saves
+#define RASTER_THREAD_MIN_TRIANGLES 32
+
+class TileBinner {
+private:
+    // Set up triangles in draw order
+    DynamicArray<RasterTriangle> triangles;
+    // Triangle indices grouped by tile: [tile_start[i], tile_start[i + 1]) of tile i
+    DynamicArray<uint32_t> tile_triangles;
+    uint32_t tile_start[RASTER_TILE_COUNT + 1];
+
+    // Fills tile_triangles. Returns false if it does not fit in memory.
+    bool bin();
+    // Returns pixels written
+    uint32_t rasterizeTile(unsigned tile);
+
+#ifdef PC
+    // Per tile result of the jobs
+    uint32_t tile_written[RASTER_TILE_COUNT];
+#endif
+
+public:
+    // Same as drawTriangle / drawTriangleDepth, drawn at the next flush()
+    void addTriangle(
+        const int16_t_Point2d& v0, const int16_t_Point2d& v1, const int16_t_Point2d& v2,
+        const MipLevel& texture,
+        Fix16 lightInstensity = 1.0f
+    );
+    void addTriangleDepth(
+        const int16_t_Point2d& v0, const int16_t_Point2d& v1, const int16_t_Point2d& v2,
+        uint16_t z0, uint16_t z1, uint16_t z2,
+        const MipLevel& texture,
+        Fix16 lightInstensity = 1.0f
+    );
+
+    // Draws and drops every added triangle
+    void flush();
+
+    unsigned get_triangleCount() const { return triangles.getSize(); }
+};
@@ -14,6 +14,7 @@
 #else
 #include <string.h>
 #include <stdio.h> // For printf if debug used
+#include <stdint.h>
 #endif
 
 // Extern declarations
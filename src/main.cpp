@@ -13,6 +13,16 @@
 
 #include "DynamicLinkedList.hpp"
 
+#include "InputRecord.hpp"
+
+#include "Profiler.hpp"
+
+#include "DirtyRects.hpp"
+
+#ifdef PC
+#   include "Pipeline.hpp"
+#endif
+
 #ifndef PC
 #   include <appdef.h>
 #   include <sdk/calc/calc.h>
@@ -30,8 +40,15 @@ APP_AUTHOR("Henri")
 APP_VERSION("0.0.1")
 
 #else
+#   ifndef HEADLESS
     // SDL2 as our graphics library
-#   include <SDL2/SDL.h>
+#       include <SDL2/SDL.h>
+#   else
+    // Off-screen benchmark harness replaces SDL2 window and key events
+#       include "Benchmark.hpp"
+#       include "Golden.hpp"
+    extern uint32_t screenPixels[SCREEN_X * SCREEN_Y];
+#   endif
     // This is not a standard "header"!
     // These functions are pretty much 1-to-1 copied from hollyhock2
     // sdk but instead of drawing to calculator screen (vram)
@@ -40,6 +57,7 @@ APP_VERSION("0.0.1")
 #   include <iostream>  // std::string
 #   include <unistd.h>  // File open & close
 #   include <fcntl.h>   // File open & close
+#   include <string.h>  // memset
 #endif
 
 // Keymappings, both ClassPad and SDL2
@@ -108,19 +126,9 @@ extern int fps10;
 #define CAMERA_SPEED      1.15f
 #define FOV_UPDATE_SPEED 20.0f
 
-inline fix16_vec2 calculate2DForward(const fix16_vec2& rotation2D) {
-    const Fix16 pitch = rotation2D.x;
 
-    fix16_vec2 forward;
-    forward.x = fix16_sin(pitch) ;
-    forward.y = fix16_cos(pitch) ;
 
-    return forward;
-}
-
-
-
-void init_map(Renderer* renderer)
+void init_map(Renderer* renderer, const char* map_path)
 {
 #ifdef PC
     std::cout << "map reading" << std::endl;
@@ -133,13 +141,6 @@ void init_map(Renderer* renderer)
         "\\fls0\\big_endian_test2.pkObj";
 #endif
 
-    char map_path[] =
-#ifdef PC
-        "./python/little_map.map";
-#else
-        "\\fls0\\big_map.map";
-#endif
-
 #ifndef PC
     FILE* fd = fopen(map_path, "rb");
 #else
@@ -242,6 +243,12 @@ int main()
 #else // ifdef PC
 int main(int argc, const char * argv[])
 {
+#ifdef HEADLESS
+    BenchConfig bench_config;
+    if (!bench_parse_args(argc, argv, bench_config))
+        return 1;
+    uint32_t bench_frame = 0;
+#else
     SDL_Window *window;
     SDL_Renderer *sdl_renderer;
     SDL_Texture * texture;
@@ -252,7 +259,7 @@ int main(int argc, const char * argv[])
         1000, 35, 24, 16, 12, 9
     };
     uint32_t SDL2_MAX_FRAMERATE = SDL2_MAX_FRAMERATE_LIST[sdl_frame_rate_i];
-
+#endif // HEADLESS
 
 #endif // PC
 
@@ -271,8 +278,8 @@ int main(int argc, const char * argv[])
     bool key_a = false;
     bool key_d = false;
     bool key_e = false;
-    bool key_z = false;
-    bool key_clear = false;
+    [[maybe_unused]] bool key_z = false;
+    [[maybe_unused]] bool key_clear = false;
 
     // Calculator Specific Variables to avoid collisions
 #ifndef PC
@@ -296,7 +303,7 @@ int main(int argc, const char * argv[])
     bool key_space = false;
 #endif
 
-    bool KEY_MOVE_LEFT_prev = false;
+    [[maybe_unused]] bool KEY_MOVE_LEFT_prev = false;
 
     bool KEY_RENDER_MODE_prev = false; // De-bouncing the button
     bool camera_position_prev = false; // De-bouncing the button
@@ -314,13 +321,16 @@ int main(int argc, const char * argv[])
         "\\fls0\\big_endian_my_car.texture";
 #endif
 
-    char model2_path[] =
+    const char* map_path =
 #ifdef PC
-        "./3D_Converted_Models/little_endian_test2.pkObj";
+        "./python/little_map.map";
 #else
-        "\\fls0\\big_endian_test2.pkObj";
+        "\\fls0\\big_map.map";
+#endif
+#ifdef HEADLESS
+    if (bench_config.map_path)
+        map_path = bench_config.map_path;
 #endif
-
 
     fillScreen(FILL_SCREEN_COLOR);
 #ifndef PC
@@ -334,16 +344,16 @@ int main(int argc, const char * argv[])
 // ~~~~~~~~~~~  Creating Renderer and Models ~~~~~~~~~~~
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-    #define CAMERA_HEIGHT 10.0f
-
     // Create renderer
     Renderer renderer;
     renderer.get_lightPos().y = -10.0f;
     renderer.get_camera_pos().y = -CAMERA_HEIGHT;
 
-#ifdef PC
+#if defined(PC) && !defined(HEADLESS)
     int init_status = renderer.custom_sdl2_init(&window, &sdl_renderer, &texture);
     if (init_status != 0) return init_status;
+    // One job thread per core
+    job_system.set_threads(0);
 #endif
 
     // Create Car Model
@@ -355,21 +365,76 @@ int main(int argc, const char * argv[])
     car_Model->_calculateEncapsulatingSphere();
 
     // Create map out of file
-    init_map(&renderer);
+#ifdef HEADLESS
+    bench_load_begin();
+#endif
+    init_map(&renderer, map_path);
+#ifdef HEADLESS
+    bench_load_end();
+#endif
+
+#ifdef HEADLESS
+    renderer.get_farDistance() = bench_config.far_distance;
+    renderer.get_zBuffer()     = bench_config.z_buffer;
+    job_system.set_threads(bench_config.threads);
+    bench_config.threads = job_system.get_threads();
+
+    if (bench_config.golden_write_dir || bench_config.golden_check_dir)
+        return golden_run(bench_config, renderer, car_Model) ? 0 : 1;
+
+    car_Model->render_mode = bench_config.render_mode;
+
+    // Replay: recorded inputs replace the input script
+    DynamicArray<InputFrame> replay_frames;
+    if (bench_config.replay_path) {
+        if (!load_input_recording(bench_config.replay_path, replay_frames)) {
+            std::cout << "Could not read recording " << bench_config.replay_path << std::endl;
+            return 1;
+        }
+        if (bench_config.frames > replay_frames.getSize())
+            bench_config.frames = replay_frames.getSize();
+    }
+    if (!bench_open(bench_config))
+        return 1;
+#endif
+
+#ifdef PC
+    // Record: inputs of every simulated frame are written to file
+    InputRecorder input_recorder;
+    #ifdef HEADLESS
+    const char* record_path = bench_config.record_path;
+    #else
+    const char* record_path = nullptr;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0)
+            record_path = argv[i + 1];
+    }
+    #endif
+    if (record_path && !input_recorder.open(record_path)) {
+        std::cout << "Could not create recording " << record_path << std::endl;
+        return 1;
+    }
+#endif
 
     // Car logic update
     Car car = Car();
     car.get_rot() = fix16_pi;
 
-#ifdef PC
+#if defined(PC) && !defined(HEADLESS)
     uint32_t time_t0 = SDL_GetTicks();
     int accumulative_frames  = 0;
     uint32_t last_fps = 0;
     bool PC_ALLOW_RENDER = true;
+#elif defined(HEADLESS)
+    bool PC_ALLOW_RENDER = true;
 #endif
 
     // Delta-time
+#ifndef HEADLESS
     Fix16 last_dt = Fix16((int16_t) 0.0016f);
+#else
+    Fix16 last_dt = bench_config.dt;
+#endif
 
     bool accelerate = false;
     bool turn_left  = false;
@@ -382,12 +447,57 @@ int main(int argc, const char * argv[])
 
     uint16_t camera_position_preset = 0;
 
+    // Render mode keys change this, the car model gets it with the frame it belongs to
+    uint16_t car_render_mode = car_Model->render_mode;
+
+#ifdef HEADLESS
+    uint32_t car_checksum = 0;
+    // Simulated frames the screen shows, pipelined it is one behind
+    uint32_t shown_frames = 0;
+    // Replay or --verify found a difference, frames after it are not checked
+    bool diverged = false;
+#endif
+
+#ifdef PC
+    // Pipelined: collisions and physics on their own thread (see Pipeline.hpp)
+    ScenePipeline* pipeline = nullptr;
+    #ifdef HEADLESS
+    const bool pipelined = bench_config.pipeline;
+    #else
+    bool pipelined = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--pipeline") == 0)
+            pipelined = true;
+    }
+    #endif
+    if (pipelined) {
+        // Headless draws every frame in order to keep checksums deterministic
+        #ifdef HEADLESS
+        const bool lockstep = true;
+        #else
+        const bool lockstep = false;
+        #endif
+        pipeline = new ScenePipeline(renderer, car_Model, car, camera_car_distance, camera_position_preset,
+            &input_recorder, lockstep);
+        if (!pipeline->start()) {
+            std::cout << "No memory for pipelining, running serially" << std::endl;
+            delete pipeline;
+            pipeline = nullptr;
+        }
+    }
+    #ifdef HEADLESS
+    bench_config.pipeline = (pipeline != nullptr);
+    #endif
+#endif
+
     while(!done)
     {
 
 #ifndef PC
         // FPS & delta-time count timer
         fps_update();
+#elif defined(HEADLESS)
+        bench_frame_begin();
 #endif
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -422,6 +532,18 @@ int main(int argc, const char * argv[])
                 }
             }
         }
+#elif defined(HEADLESS)
+        // Scripted key presses (replayed frames set their inputs directly below)
+        if (!bench_config.replay_path) {
+            const BenchInput in = bench_script_input(bench_frame);
+            key_w     = in.accelerate;
+            key_s     = in.brake;
+            key_a     = in.turn_left;
+            key_d     = in.turn_right;
+            key_space = in.boost;
+            key_e     = in.render_mode;
+            key_right = in.camera_preset;
+        }
 #else // !PC -> PC
         // Get the next event
         SDL_Event event;
@@ -505,7 +627,7 @@ int main(int argc, const char * argv[])
         if (KEY_MOVE_LEFT) {
             //renderer.get_camera_rot().y += last_dt * 1.0f;
 
-            #ifdef PC
+            #if defined(PC) && !defined(HEADLESS)
             if(KEY_MOVE_LEFT_prev == false){
                 sdl_frame_rate_i = (sdl_frame_rate_i+1) % SDL2_MAX_FRAMERATE_LIST_COUNT;
                 SDL2_MAX_FRAMERATE = SDL2_MAX_FRAMERATE_LIST[sdl_frame_rate_i];
@@ -513,7 +635,7 @@ int main(int argc, const char * argv[])
             KEY_MOVE_LEFT_prev = true;
             #endif
         }
-        #ifdef PC
+        #if defined(PC) && !defined(HEADLESS)
         else {
             KEY_MOVE_LEFT_prev = false;
         }
@@ -521,33 +643,9 @@ int main(int argc, const char * argv[])
 
         if (KEY_MOVE_RIGHT) {
             if (camera_position_prev == false){
-
-                const uint16_t camera_position_preset_COUNT = 4;
-                camera_position_preset = (camera_position_preset+1) % camera_position_preset_COUNT;
-                if (camera_position_preset == 0){
-                    renderer.get_FOV() = 150.0f;
-                    camera_car_distance         = 9.0f;
-                    renderer.get_camera_pos().y = -CAMERA_HEIGHT;
-                    renderer.get_camera_rot().y = 0.1f;
-                }
-                else if (camera_position_preset == 1){
-                    renderer.get_FOV() = 150.0f;
-                    camera_car_distance         = 6.0f;
-                    renderer.get_camera_pos().y = -CAMERA_HEIGHT-6.0f;
-                    renderer.get_camera_rot().y = 0.1f;
-                }
-                else if (camera_position_preset == 2){
-                    renderer.get_FOV() = 130.0f;
-                    camera_car_distance         = 3.0f;
-                    renderer.get_camera_pos().y = -CAMERA_HEIGHT-15.0f;
-                    renderer.get_camera_rot().y = 0.5f;
-                }
-                else if (camera_position_preset == 3){
-                    renderer.get_FOV() = 120.0f;
-                    camera_car_distance         = 1.0f;
-                    renderer.get_camera_pos().y = -CAMERA_HEIGHT-21.0f;
-                    renderer.get_camera_rot().y = 0.5f;
-                }
+                camera_position_preset = (camera_position_preset+1) % CAMERA_POSITION_PRESET_COUNT;
+                apply_camera_preset(camera_position_preset, renderer.get_camera_pos(), renderer.get_camera_rot(),
+                    renderer.get_FOV(), camera_car_distance);
             }
             camera_position_prev = true;
         } else {
@@ -575,10 +673,10 @@ int main(int argc, const char * argv[])
 
         if (KEY_MOVE_REND_MODE){
             if(KEY_RENDER_MODE_prev == false){
-                if(car_Model->render_mode < RENDER_MODE_COUNT-1)
-                    car_Model->render_mode = car_Model->render_mode + 1;
+                if(car_render_mode < RENDER_MODE_COUNT-1)
+                    car_render_mode = car_render_mode + 1;
                 else
-                    car_Model->render_mode = 0;
+                    car_render_mode = 0;
             }
             KEY_RENDER_MODE_prev = true;
         } else {
@@ -613,75 +711,115 @@ int main(int argc, const char * argv[])
     if (PC_ALLOW_RENDER)
     {
 #endif
-        // ~~~~~~~~~~~~~~~~~~~~~  Collisions ~~~~~~~~~~~~~~~~~~~~~
-        for (auto iter = renderer.getModelArray().node_begin(); iter != renderer.getModelArray().node_end(); ++iter) {
-            auto node = (*iter);
-            if (node->data.first == car_Model)
-                continue;
-            const auto modelPos = node->data.first->getPosition_ref();
-            const auto carPos   = car_Model->getPosition_ref();
-            const auto combinedPos = sub_vec3(carPos, modelPos);
-            Fix16 dist = calculateLength(combinedPos);
-            if(dist <= (node->data.first->encapsulating_radius + car_Model->encapsulating_radius)/2.0f)
+#ifdef HEADLESS
+        if (bench_config.replay_path) {
+            const InputFrame& in = replay_frames[bench_frame];
+            if (!bench_config.dt_override)
+                last_dt = Fix16(in.dt);
+            accelerate = (in.keys & INPUT_ACCELERATE);
+            car_break  = (in.keys & INPUT_BRAKE);
+            turn_left  = (in.keys & INPUT_TURN_LEFT);
+            turn_right = (in.keys & INPUT_TURN_RIGHT);
+            boost      = (in.keys & INPUT_BOOST);
+            car_render_mode = in.render_mode;
+            if (in.camera_preset != camera_position_preset) {
+                camera_position_preset = in.camera_preset;
+                apply_camera_preset(camera_position_preset, renderer.get_camera_pos(), renderer.get_camera_rot(),
+                    renderer.get_FOV(), camera_car_distance);
+            }
+        }
+#endif
+#ifdef PC
+        InputFrame input_frame;
+        input_frame.dt   = last_dt.value;
+        input_frame.keys = (accelerate ? INPUT_ACCELERATE : 0)
+                         | (car_break  ? INPUT_BRAKE      : 0)
+                         | (turn_left  ? INPUT_TURN_LEFT  : 0)
+                         | (turn_right ? INPUT_TURN_RIGHT : 0)
+                         | (boost      ? INPUT_BOOST      : 0);
+        input_frame.render_mode   = (uint8_t) car_render_mode;
+        input_frame.camera_preset = (uint8_t) camera_position_preset;
+        input_frame.reserved      = 0;
+
+        if (pipeline) {
+            pipeline->submit(input_frame);
+            // Drawn while the frame just submitted is simulated
+            const SceneSnapshot& scene = pipeline->acquire();
+            pipeline->apply(scene, renderer, car_Model);
+    #ifdef HEADLESS
+            car_checksum = scene.input.car_checksum;
+            shown_frames = scene.frames;
+            if (bench_config.replay_path && scene.frames > 0
+                && replay_frames[scene.frames - 1].car_checksum != car_checksum) {
+                std::cout << "Replay diverged from recording at frame " << scene.frames - 1 << std::endl;
+                done = diverged = true;
+            }
+    #endif
             {
-                if(node->data.first->collision_extra == 2){
-
-                    car.add_boost(MAX_BOOST_TIME/4.0f);
-                    // --- Remove boost ----
-                    // Free memory of the created model
-                    delete node->data.first;
-                    // Remove node (internally frees its data)
-                    renderer.getModelArray().remove(*node); // Removing by node is very fast
-                }
-                else if (node->data.first->collision_extra == 1){
-                    // Wall
-                    car.get_speed() = -15.0f;
-                }
+                PROFILE_ZONE(PROF_UI);
+                scene.car.draw_UI();
+            }
+        }
+        else {
+#endif
+        // ~~~~~~~~~~~~~~~~~~~~~  Collisions ~~~~~~~~~~~~~~~~~~~~~
+        {
+            PROFILE_ZONE(PROF_COLLISION);
+            for (auto iter = renderer.getModelArray().node_begin(); iter != renderer.getModelArray().node_end(); ++iter) {
+                auto node = (*iter);
+                if (node->data.first == car_Model)
+                    continue;
+                const auto modelPos = node->data.first->getPosition_ref();
+                const auto carPos   = car_Model->getPosition_ref();
+                const auto combinedPos = sub_vec3(carPos, modelPos);
+                Fix16 dist = calculateLength(combinedPos);
+                if(dist <= (node->data.first->encapsulating_radius + car_Model->encapsulating_radius)/2.0f)
+                {
+                    if(node->data.first->collision_extra == 2){
+
+                        car.add_boost(MAX_BOOST_TIME/4.0f);
+                        // --- Remove boost ----
+                        // Free memory of the created model
+                        delete node->data.first;
+                        // Remove node (internally frees its data)
+                        renderer.getModelArray().remove(*node); // Removing by node is very fast
+                    }
+                    else if (node->data.first->collision_extra == 1){
+                        // Wall
+                        car.get_speed() = -15.0f;
+                    }
 
-                // Only one collision per loop
-                break;
+                    // Only one collision per loop
+                    break;
+                }
             }
         }
 
         // Assuming camera has always moved due to car rolling always
         renderer.camera_move_dirty = true;
 
-        // Due to numerical inaccuracies in fixed point math,
-        // when delta time gets too large lets update twice.
-        uint16_t update_count = 4;
-        last_dt = last_dt/4.0f;
-        // Update in loop logic thats dependent on delta time
-        for (uint16_t i=0; i<update_count; i++)
         {
-            car.update(last_dt, accelerate, car_break, turn_left, turn_right, boost);
-
-            // Effect: Camera position lagging behind to give sense of speed
-            auto cam_forward = calculate2DForward(renderer.get_camera_rot());
-            const Fix16 cam_targ_x = car.get_pos().x - (cam_forward.x * camera_car_distance);
-            const Fix16 cam_targ_y = car.get_pos().y - (cam_forward.y * camera_car_distance);
-            renderer.get_camera_pos().x = easeInLinear(renderer.get_camera_pos().x, cam_targ_x, last_dt, 5.0f);
-            renderer.get_camera_pos().z = easeInLinear(renderer.get_camera_pos().z, cam_targ_y, last_dt, 5.0f);
-
-            // Effect: Camera rotation slightly lagging behind
-            renderer.get_camera_rot().x = easeInLinear(renderer.get_camera_rot().x, car.get_rot(),
-                last_dt,
-                Fix16(3.5f)
-            );
-
-            // Update car model rotation
-            // Effect: Slight delay in actual rotation makes it look both smoother and more "real"
-            car_Model->getRotation_ref().x = easeInLinear(car_Model->getRotation_ref().x, car.get_rot() + Fix16(fix16_pi), last_dt, 5.5f);
+            PROFILE_ZONE(PROF_PHYSICS);
+            update_car_frame(car, last_dt, accelerate, car_break, turn_left, turn_right, boost,
+                camera_car_distance, renderer.get_camera_pos(), renderer.get_camera_rot(),
+                car_Model->getRotation_ref().x);
         }
-        // Reset the key states
-        accelerate = false;
-        car_break  = false;
-        boost = false;
-        turn_left  = false;
-        turn_right = false;
-
+#ifdef PC
+        input_frame.car_checksum = car.state_checksum();
+        input_recorder.write(input_frame);
+#endif
+#ifdef HEADLESS
+        car_checksum = car.state_checksum();
+        shown_frames = bench_frame + 1;
+        if (bench_config.replay_path && replay_frames[bench_frame].car_checksum != car_checksum) {
+            std::cout << "Replay diverged from recording at frame " << bench_frame << std::endl;
+            done = diverged = true;
+        }
+#endif
         // Update car model position
         car_Model->position.x = car.get_pos().x;
         car_Model->position.z = car.get_pos().y;
+        car_Model->render_mode = car_render_mode;
 
         // Effect: FOV change based on speed
         renderer.get_FOV() = Fix16(170.0f) - car.get_speed_perc()*30.0f;
@@ -690,7 +828,21 @@ int main(int argc, const char * argv[])
         renderer.get_minimapPos().y = -car.get_pos().y;
 
         // Draw car UI
-        car.draw_UI();
+        {
+            PROFILE_ZONE(PROF_UI);
+            car.draw_UI();
+        }
+
+#ifdef PC
+        } // !pipeline
+#endif
+
+        // Reset the key states
+        accelerate = false;
+        car_break  = false;
+        boost = false;
+        turn_left  = false;
+        turn_right = false;
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // ~~~~~~~~~~~~~~~~~~~~~ Rendering ~~~~~~~~~~~~~~~~~~~~~
@@ -698,6 +850,11 @@ int main(int argc, const char * argv[])
 
         renderer.update();
 
+#if defined(FRAME_PROFILER) && !defined(HEADLESS)
+        // Timing text would make headless screen checksums non-deterministic
+        profiler_draw_overlay();
+#endif
+
 #ifdef PC
     } // (PC_ALLOW_RENDER)
 #endif
@@ -712,6 +869,9 @@ int main(int argc, const char * argv[])
         fps_formatted_update();
         fps_display();
         last_dt = Fix16(1.0f) / (Fix16(((int16_t) fps10)) / 10.0f);
+#elif defined(HEADLESS)
+        // Fixed delta-time
+        last_dt = bench_config.dt;
 #else
         // SDL_GetTicks() seems not to be super accurate, so adding frames to
         // accumulative_frames and updating the frame counter with some period
@@ -730,6 +890,7 @@ int main(int argc, const char * argv[])
             PC_ALLOW_RENDER = false;
             }
         sdl_debug_uint32_t(last_fps, 10, 10); // Support ONLY numbers 0-9!
+        dirty_rects.add(10, 10, 50, 6*4);
 #endif
         // // Limit Delta-time -> when it starts to be too high then car update loop
         // if(last_dt > 0.09f) last_dt = 0.09f;
@@ -739,25 +900,66 @@ int main(int argc, const char * argv[])
 #ifdef PC
     if (PC_ALLOW_RENDER)
     {
+#endif
+#ifdef HEADLESS
+        // Checksum of the finished frame before it gets cleared (not of the
+        // scene before the first frame a pipelined run draws first)
+        if (shown_frames > 0
+            && !bench_checksum_frame(shown_frames - 1, car_checksum, fnv1a_32(screenPixels, sizeof(screenPixels))))
+            done = diverged = true;
 #endif
         // Refershes screen and clears vram for new frame
         // 1. Refersh screen
         // 2. Clear VRAM for new frame
         renderer.screen_flush();
-        car.clear_UI();
+
+#ifdef FRAME_PROFILER
+        profiler_frame_end();
+#endif
 
 #ifdef PC
     } // (PC_ALLOW_RENDER)
 #endif
 
+#ifdef HEADLESS
+        bench_frame_end();
+        if (++bench_frame >= bench_config.frames)
+            done = true;
+#endif
+
     } // while(!done)
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // ~~~~~~~~~~~~~~~~~~~~ End Program ~~~~~~~~~~~~~~~~~~~~
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
+#ifdef HEADLESS
+    // Pipelined, the loop ends with the last frame simulated but not drawn.
+    // Draw and check it like the serial loop would (not timed).
+    if (pipeline && !diverged && shown_frames < bench_frame) {
+        const SceneSnapshot& scene = pipeline->acquire();
+        pipeline->apply(scene, renderer, car_Model);
+        car_checksum = scene.input.car_checksum;
+        shown_frames = scene.frames;
+        if (bench_config.replay_path && replay_frames[scene.frames - 1].car_checksum != car_checksum)
+            std::cout << "Replay diverged from recording at frame " << scene.frames - 1 << std::endl;
+        scene.car.draw_UI();
+        renderer.update();
+        bench_checksum_frame(shown_frames - 1, car_checksum, fnv1a_32(screenPixels, sizeof(screenPixels)));
+        renderer.screen_flush();
+    }
+#endif
+
+#ifdef PC
+    // Simulates the inputs left (recording them) and ends its thread
+    delete pipeline;
+#endif
+
 #ifndef PC
     return 0;
+#elif defined(HEADLESS)
+    bench_report(bench_config, renderer.getModelCount(), renderer.get_frameArena().get_high_water());
+    return 0;
 #else
     // End program without leaking memory
     SDL_DestroyTexture(texture);
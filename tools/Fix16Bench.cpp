@@ -0,0 +1,231 @@
+// libfixmath / Fix16_Utils microbenchmark (host only).
+//
+// Measures ns/op of the fixed point functions the renderer and the car
+// physics spend their time in. The math configuration is chosen at compile
+// time, so "make fixbench" builds one binary per configuration
+// (dist/fixbench_<variant>) and each prints its own table:
+//   shipped    FIXMATH_SATURATING_ARITHMETIC (GLOBAL_CONSTANTS.hpp)
+//   nosat      Overflow checked but not saturating
+//   nooverflow FIXMATH_NO_OVERFLOW
+//   fastsin    shipped + FIXMATH_FAST_SIN
+//   sinlut     shipped + FIXMATH_SIN_LUT
+//
+// Inputs come from a fixed seed and follow what the game feeds these
+// functions (vertex coordinates, perspective depths, accumulated angles...).
+// "max err" is the largest absolute error against double precision.
+
+#include "../src/libfixmath/fix16.hpp"
+#include "../src/Fix16_Utils.hpp"
+
+#include <algorithm> // std::min
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+#ifndef FIXBENCH_VARIANT
+#   define FIXBENCH_VARIANT "unknown"
+#endif
+
+#define INPUT_COUNT   4096 // Power of two
+#define BENCH_REPEATS 7    // Best of
+#define BENCH_MIN_NS  20000000ull
+
+// ~~~~~~~~~~~~~~~~ Inputs ~~~~~~~~~~~~~~~~
+
+static uint32_t rng_state = 0x12345678u;
+
+static uint32_t xorshift32()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static double uniform(double lo, double hi)
+{
+    return lo + (hi - lo) * (xorshift32() / 4294967296.0);
+}
+
+struct Inputs
+{
+    fix16_t coord[INPUT_COUNT];   // Vertex coordinates relative to camera [-200, 200]
+    fix16_t unit[INPUT_COUNT];    // sin/cos products, light intensity [-1, 1]
+    fix16_t depth[INPUT_COUNT];   // Perspective divide depth [0.5, 300]
+    fix16_t angle[INPUT_COUNT];   // Car/camera rotation, accumulates past 2PI [-4PI, 4PI]
+    fix16_t length2[INPUT_COUNT]; // Squared lengths [0, 40000]
+    fix16_vec3 vec[INPUT_COUNT];  // Model space vectors [-50, 50]
+};
+
+static Inputs inputs;
+
+static void generate_inputs()
+{
+    for (unsigned i = 0; i < INPUT_COUNT; i++) {
+        inputs.coord[i]   = fix16_from_dbl(uniform(-200.0, 200.0));
+        inputs.unit[i]    = fix16_from_dbl(uniform(-1.0, 1.0));
+        inputs.depth[i]   = fix16_from_dbl(uniform(0.5, 300.0));
+        inputs.angle[i]   = fix16_from_dbl(uniform(-4.0 * M_PI, 4.0 * M_PI));
+        inputs.length2[i] = fix16_from_dbl(uniform(0.0, 40000.0));
+        inputs.vec[i]     = {
+            Fix16(uniform(-50.0, 50.0)), Fix16(uniform(-50.0, 50.0)), Fix16(uniform(-50.0, 50.0))
+        };
+    }
+}
+
+// ~~~~~~~~~~~~~~~~ Timing ~~~~~~~~~~~~~~~~
+
+// Keeps results alive so the calls are not optimized out
+static volatile fix16_t sink;
+
+// Runs body(i) over all inputs until BENCH_MIN_NS has passed, best of BENCH_REPEATS
+template <typename Body>
+static double time_ns_per_op(Body body)
+{
+    double best = 1e30;
+    for (unsigned r = 0; r < BENCH_REPEATS; r++) {
+        uint64_t ops = 0;
+        uint64_t elapsed = 0;
+        fix16_t acc = 0;
+        const auto t0 = std::chrono::steady_clock::now();
+        while (elapsed < BENCH_MIN_NS) {
+            for (unsigned i = 0; i < INPUT_COUNT; i++)
+                acc ^= body(i);
+            ops += INPUT_COUNT;
+            elapsed = (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - t0
+            ).count();
+        }
+        sink = acc;
+        best = std::min(best, (double) elapsed / ops);
+    }
+    return best;
+}
+
+template <typename Fixed, typename Reference>
+static double max_error(Fixed fixed, Reference reference)
+{
+    double err = 0.0;
+    for (unsigned i = 0; i < INPUT_COUNT; i++)
+        err = std::max(err, std::fabs(fix16_to_dbl(fixed(i)) - reference(i)));
+    return err;
+}
+
+static void report(const char* name, double ns, double err = -1.0)
+{
+    if (err < 0.0)
+        printf("  %-26s %8.2f\n", name, ns);
+    else
+        printf("  %-26s %8.2f %12.6f\n", name, ns, err);
+}
+
+static double dbl(fix16_t x) { return fix16_to_dbl(x); }
+
+// ~~~~~~~~~~~~~~~~ Benchmarks ~~~~~~~~~~~~~~~~
+
+int main()
+{
+    generate_inputs();
+    const unsigned mask = INPUT_COUNT - 1;
+
+    printf("fix16 microbenchmark, variant: %s\n", FIXBENCH_VARIANT);
+    printf("  %-26s %8s %12s\n", "op", "ns/op", "max err");
+
+    // Multiply: coordinate * rotation/lighting factor
+    report("fix16_mul", time_ns_per_op([&](unsigned i) {
+        return fix16_mul(inputs.coord[i], inputs.unit[(i + 1) & mask]);
+    }), max_error(
+        [&](unsigned i) { return fix16_mul(inputs.coord[i], inputs.unit[(i + 1) & mask]); },
+        [&](unsigned i) { return dbl(inputs.coord[i]) * dbl(inputs.unit[(i + 1) & mask]); }
+    ));
+#ifndef FIXMATH_NO_OVERFLOW
+    report("fix16_smul", time_ns_per_op([&](unsigned i) {
+        return fix16_smul(inputs.coord[i], inputs.unit[(i + 1) & mask]);
+    }));
+#endif
+
+    // Divide: perspective divide of a coordinate by its depth
+    report("fix16_div", time_ns_per_op([&](unsigned i) {
+        return fix16_div(inputs.coord[i], inputs.depth[i]);
+    }), max_error(
+        [&](unsigned i) { return fix16_div(inputs.coord[i], inputs.depth[i]); },
+        [&](unsigned i) { return dbl(inputs.coord[i]) / dbl(inputs.depth[i]); }
+    ));
+#ifndef FIXMATH_NO_OVERFLOW
+    report("fix16_sdiv", time_ns_per_op([&](unsigned i) {
+        return fix16_sdiv(inputs.coord[i], inputs.depth[i]);
+    }));
+#endif
+
+    // Add: the saturating variants are what Fix16 operator+ uses when shipped
+#ifndef FIXMATH_NO_OVERFLOW
+    report("fix16_add", time_ns_per_op([&](unsigned i) {
+        return fix16_add(inputs.coord[i], inputs.coord[(i + 1) & mask]);
+    }));
+    report("fix16_sadd", time_ns_per_op([&](unsigned i) {
+        return fix16_sadd(inputs.coord[i], inputs.coord[(i + 1) & mask]);
+    }));
+#endif
+
+    // Trigonometry (FIXMATH_NO_CACHE: polynomial unless FIXMATH_SIN_LUT)
+    report("fix16_sin", time_ns_per_op([&](unsigned i) {
+        return fix16_sin(inputs.angle[i]);
+    }), max_error(
+        [&](unsigned i) { return fix16_sin(inputs.angle[i]); },
+        [&](unsigned i) { return sin(dbl(inputs.angle[i])); }
+    ));
+    report("fix16_cos", time_ns_per_op([&](unsigned i) {
+        return fix16_cos(inputs.angle[i]);
+    }), max_error(
+        [&](unsigned i) { return fix16_cos(inputs.angle[i]); },
+        [&](unsigned i) { return cos(dbl(inputs.angle[i])); }
+    ));
+    // Parabola approximation is only valid on [-PI, PI], wrap like fix16_sin does
+    const auto wrap_pi = [](fix16_t a) {
+        a %= (fix16_pi << 1);
+        if (a > fix16_pi)       a -= (fix16_pi << 1);
+        else if (a < -fix16_pi) a += (fix16_pi << 1);
+        return a;
+    };
+    report("fix16_sin_parabola", time_ns_per_op([&](unsigned i) {
+        return fix16_sin_parabola(wrap_pi(inputs.angle[i]));
+    }), max_error(
+        [&](unsigned i) { return fix16_sin_parabola(wrap_pi(inputs.angle[i])); },
+        [&](unsigned i) { return sin(dbl(inputs.angle[i])); }
+    ));
+
+    report("fix16_sqrt", time_ns_per_op([&](unsigned i) {
+        return fix16_sqrt(inputs.length2[i]);
+    }), max_error(
+        [&](unsigned i) { return fix16_sqrt(inputs.length2[i]); },
+        [&](unsigned i) { return sqrt(dbl(inputs.length2[i])); }
+    ));
+
+    // Fix16_Utils (Fix16 operators follow the arithmetic configuration)
+    report("calculateLength", time_ns_per_op([&](unsigned i) {
+        return (fix16_t) calculateLength(inputs.vec[i]);
+    }), max_error(
+        [&](unsigned i) { return (fix16_t) calculateLength(inputs.vec[i]); },
+        [&](unsigned i) {
+            const fix16_vec3& v = inputs.vec[i];
+            return sqrt(dbl(v.x) * dbl(v.x) + dbl(v.y) * dbl(v.y) + dbl(v.z) * dbl(v.z));
+        }
+    ));
+    report("crossProduct", time_ns_per_op([&](unsigned i) {
+        const fix16_vec3 c = crossProduct(inputs.vec[i], inputs.vec[(i + 1) & mask]);
+        return (fix16_t) c.x ^ (fix16_t) c.y ^ (fix16_t) c.z;
+    }));
+    report("normalize_fix16_vec3", time_ns_per_op([&](unsigned i) {
+        fix16_vec3 v = inputs.vec[i];
+        normalize_fix16_vec3(v);
+        return (fix16_t) v.x ^ (fix16_t) v.y ^ (fix16_t) v.z;
+    }), max_error(
+        [&](unsigned i) { fix16_vec3 v = inputs.vec[i]; normalize_fix16_vec3(v); return (fix16_t) v.x; },
+        [&](unsigned i) {
+            const fix16_vec3& v = inputs.vec[i];
+            return dbl(v.x) / sqrt(dbl(v.x) * dbl(v.x) + dbl(v.y) * dbl(v.y) + dbl(v.z) * dbl(v.z));
+        }
+    ));
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+// Synthetic .map generator for scaling benchmarks (host only).
+//
+// Writes the same format as python/MapCreator.py:
+//   uint32 element count, then per element: Fix16 x, Fix16 y, uint32 type
+// Elements sit on a grid of SQUARE_SIZE units with the player (type 0) in the
+// middle. The cells around the player are kept empty so the car does not
+// start inside a wall.
+//
+//   ./dist/mapgen --size 100 100 --wall-density 0.2 --boosts 50 big.map
+//   ./dist/headless --map big.map
+
+#include "../src/libfixmath/fix16.h"
+
+#include <cstdio>
+#include <cstdlib> // atoi, atof
+#include <cstring> // strcmp, memset
+
+#define SQUARE_SIZE 10.0
+
+// Same values as MapElementTypes in python/MapCreator.py
+enum MAP_ELEMENT_TYPES : uint32_t {
+    MAP_PLAYER = 0,
+    MAP_WALL   = 1,
+    MAP_BOOST  = 2
+};
+
+static uint32_t rng_state;
+
+static uint32_t xorshift32()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void write_u32(FILE* f, uint32_t value, bool big_endian)
+{
+    uint8_t b[4];
+    for (int i = 0; i < 4; i++)
+        b[big_endian ? 3 - i : i] = (uint8_t) (value >> (8 * i));
+    fwrite(b, 1, 4, f);
+}
+
+static void usage(const char* exe)
+{
+    printf(
+        "Usage: %s [options] OUTPUT.map\n"
+        "  --size W H          Grid size in cells (default 26 30, max 6400)\n"
+        "  --wall-density F    Fraction of cells that are walls (default 0.15)\n"
+        "  --boosts N          Boost count (default 10)\n"
+        "  --seed N            Random seed (default 1)\n"
+        "  --big-endian        Calculator byte order (default little endian, PC)\n",
+        exe
+    );
+}
+
+int main(int argc, const char* argv[])
+{
+    int    size_x       = 26;
+    int    size_y       = 30;
+    double wall_density = 0.15;
+    int    boosts       = 10;
+    bool   big_endian   = false;
+    const char* out_path = nullptr;
+    rng_state = 1;
+
+    for (int i = 1; i < argc; i++) {
+        const bool has_value = (i + 1 < argc);
+        if      (strcmp(argv[i], "--size") == 0 && i + 2 < argc) {
+            size_x = atoi(argv[++i]);
+            size_y = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--wall-density") == 0 && has_value)
+            wall_density = atof(argv[++i]);
+        else if (strcmp(argv[i], "--boosts") == 0 && has_value)
+            boosts = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+            // xorshift state must not be 0, every other seed is its own map
+            const uint32_t seed = (uint32_t) atoi(argv[++i]);
+            rng_state = seed ? seed : 0x9E3779B9u;
+        }
+        else if (strcmp(argv[i], "--big-endian") == 0)
+            big_endian = true;
+        else if (argv[i][0] != '-' && !out_path)
+            out_path = argv[i];
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    // Coordinates must fit in Fix16 (+-32767)
+    const int max_size = (int) (2 * 32000 / SQUARE_SIZE);
+    if (!out_path || size_x < 3 || size_y < 3 || size_x > max_size || size_y > max_size
+        || wall_density < 0.0 || wall_density > 1.0 || boosts < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Cell types, player in the middle
+    const int cell_count = size_x * size_y;
+    const uint8_t EMPTY = 0xFF;
+    uint8_t* cells = (uint8_t*) malloc(cell_count);
+    memset(cells, EMPTY, cell_count);
+    const int zero_x = size_x / 2;
+    const int zero_y = size_y / 2;
+    cells[zero_y * size_x + zero_x] = MAP_PLAYER;
+
+    const auto is_spawn_area = [&](int x, int y) {
+        return abs(x - zero_x) <= 1 && abs(y - zero_y) <= 1;
+    };
+
+    // Walls: each free cell independently
+    const uint32_t wall_threshold = (uint32_t) (wall_density * 4294967295.0);
+    uint32_t walls = 0;
+    for (int y = 0; y < size_y; y++) {
+        for (int x = 0; x < size_x; x++) {
+            if (!is_spawn_area(x, y) && xorshift32() < wall_threshold) {
+                cells[y * size_x + x] = MAP_WALL;
+                walls++;
+            }
+        }
+    }
+
+    // Boosts: random empty cells
+    int placed_boosts = 0;
+    for (int tries = 0; placed_boosts < boosts && tries < cell_count * 4; tries++) {
+        const int x = (int) (xorshift32() % size_x);
+        const int y = (int) (xorshift32() % size_y);
+        if (cells[y * size_x + x] == EMPTY && !is_spawn_area(x, y)) {
+            cells[y * size_x + x] = MAP_BOOST;
+            placed_boosts++;
+        }
+    }
+
+    FILE* f = fopen(out_path, "wb");
+    if (!f) {
+        printf("Could not create %s\n", out_path);
+        free(cells);
+        return 1;
+    }
+
+    // Player + walls + boosts
+    const uint32_t element_count = 1 + walls + placed_boosts;
+    write_u32(f, element_count, big_endian);
+    for (int y = 0; y < size_y; y++) {
+        for (int x = 0; x < size_x; x++) {
+            const uint8_t type = cells[y * size_x + x];
+            if (type == EMPTY)
+                continue;
+            write_u32(f, (uint32_t) fix16_from_dbl((x - zero_x) * SQUARE_SIZE), big_endian);
+            write_u32(f, (uint32_t) fix16_from_dbl((y - zero_y) * SQUARE_SIZE), big_endian);
+            write_u32(f, type, big_endian);
+        }
+    }
+    fclose(f);
+    free(cells);
+
+    printf("%s: %dx%d grid, %u walls, %d boosts\n", out_path, size_x, size_y, walls, placed_boosts);
+    return 0;
+}
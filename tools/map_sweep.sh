@@ -0,0 +1,31 @@
+#!/bin/sh
+# Scene size sweep: generates maps of growing size with dist/mapgen and runs
+# the headless benchmark on each. Run from the repository root after
+# "make headless mapgen".
+#
+#   tools/map_sweep.sh [frames] [grid sizes...]
+
+FRAMES=${1:-120}
+[ $# -gt 0 ] && shift
+SIZES=${*:-"25 70 160 320 500"}
+MAP=$(mktemp /tmp/sweep_XXXXXX.map)
+
+printf "%-6s %8s %10s %9s %9s %11s %11s %10s\n" \
+    grid models load_ms p50_us p99_us collision_us modelsort_us rss_kb
+for size in $SIZES; do
+    ./dist/mapgen --size "$size" "$size" --wall-density 0.2 --boosts $((size * size / 100)) "$MAP" > /dev/null || exit 1
+    ./dist/headless --frames "$FRAMES" --map "$MAP" | awk -v size="$size" '
+        /^models:/          { models = $2 }
+        /^map load/         { load = $4 }
+        /^peak RSS/         { rss = $4 }
+        /^frame time/       { p50 = $7; p99 = $9 }
+        /^stage mean/ {
+            for (i = 4; i < NF; i++) {
+                if ($i == "collision")  collision = $(i + 1)
+                if ($i == "model-sort") modelsort = $(i + 1)
+            }
+        }
+        END { printf "%-6s %8s %10s %9s %9s %11s %11s %10s\n",
+              size, models, load, p50, p99, collision, modelsort, rss }'
+done
+rm -f "$MAP"